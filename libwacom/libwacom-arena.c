@@ -0,0 +1,154 @@
+/*
+ * Copyright © 2026 Red Hat, Inc.
+ *
+ * Permission to use, copy, modify, distribute, and sell this software
+ * and its documentation for any purpose is hereby granted without
+ * fee, provided that the above copyright notice appear in all copies
+ * and that both that copyright notice and this permission notice
+ * appear in supporting documentation, and that the name of Red Hat
+ * not be used in advertising or publicity pertaining to distribution
+ * of the software without specific, written prior permission.  Red
+ * Hat makes no representations about the suitability of this software
+ * for any purpose.  It is provided "as is" without express or implied
+ * warranty.
+ *
+ * THE AUTHORS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS SOFTWARE,
+ * INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS, IN
+ * NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS
+ * OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT,
+ * NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include "libwacomint.h"
+
+#define ARENA_MIN_BLOCK_SIZE 4096
+#define ARENA_BLOCK_SIZE (64 * 1024)
+
+/* Devices, matches, styli and strings for one database, or one update of
+ * a watched database, come from a few large blocks. Nothing is freed
+ * before the arena, everything allocated from it holds a reference to
+ * it. The parallel loader allocates from multiple threads, so the arena
+ * is locked. */
+struct arena {
+	gint refcnt;
+	GMutex lock;
+	GStringChunk *strings;
+	GPtrArray *blocks;
+	char *next; /* free space in the current block */
+	size_t left;
+	size_t block_size; /* of the next block */
+};
+
+struct arena *
+libwacom_arena_new(void)
+{
+	struct arena *arena;
+
+	arena = g_new0(struct arena, 1);
+	arena->refcnt = 1;
+	g_mutex_init(&arena->lock);
+	arena->strings = g_string_chunk_new(4096);
+	arena->blocks = g_ptr_array_new_with_free_func(g_free);
+	arena->block_size = ARENA_MIN_BLOCK_SIZE;
+
+	return arena;
+}
+
+struct arena *
+libwacom_arena_ref(struct arena *arena)
+{
+	g_atomic_int_inc(&arena->refcnt);
+	return arena;
+}
+
+struct arena *
+libwacom_arena_unref(struct arena *arena)
+{
+	if (!arena || !g_atomic_int_dec_and_test(&arena->refcnt))
+		return NULL;
+
+	g_string_chunk_free(arena->strings);
+	g_ptr_array_free(arena->blocks, TRUE);
+	g_mutex_clear(&arena->lock);
+	g_free(arena);
+
+	return NULL;
+}
+
+void *
+libwacom_arena_alloc0(struct arena *arena, size_t size)
+{
+	void *mem;
+
+	/* Enough alignment for any of our structs, and never NULL for
+	 * empty arrays */
+	size = (MAX(size, 1) + 15) & ~(size_t)15;
+
+	g_mutex_lock(&arena->lock);
+
+	if (size > ARENA_BLOCK_SIZE / 4) {
+		/* Don't waste the rest of the block on a large array */
+		mem = g_malloc(size);
+		g_ptr_array_add(arena->blocks, mem);
+	} else {
+		if (size > arena->left) {
+			size_t block_size = arena->block_size;
+
+			/* Blocks grow up to ARENA_BLOCK_SIZE, an arena
+			 * for a single reloaded file stays small */
+			while (block_size < size)
+				block_size *= 2;
+
+			arena->next = g_malloc(block_size);
+			arena->left = block_size;
+			g_ptr_array_add(arena->blocks, arena->next);
+			arena->block_size = MIN(block_size * 2, ARENA_BLOCK_SIZE);
+		}
+		mem = arena->next;
+		arena->next += size;
+		arena->left -= size;
+	}
+
+	g_mutex_unlock(&arena->lock);
+
+	return memset(mem, 0, size);
+}
+
+void *
+libwacom_arena_memdup(struct arena *arena, const void *data, size_t size)
+{
+	return memcpy(libwacom_arena_alloc0(arena, size), data, size);
+}
+
+char *
+libwacom_arena_intern(struct arena *arena, const char *str)
+{
+	char *interned;
+
+	if (!str)
+		return NULL;
+
+	g_mutex_lock(&arena->lock);
+	interned = g_string_chunk_insert_const(arena->strings, str);
+	g_mutex_unlock(&arena->lock);
+
+	return interned;
+}
+
+/* Like libwacom_arena_intern() but frees str */
+char *
+libwacom_arena_take(struct arena *arena, char *str)
+{
+	char *interned = libwacom_arena_intern(arena, str);
+
+	g_free(str);
+	return interned;
+}
+
+/* vim: set noexpandtab tabstop=8 shiftwidth=8: */
@@ -0,0 +1,902 @@
+/*
+ * Copyright © 2026 Red Hat, Inc.
+ *
+ * Permission to use, copy, modify, distribute, and sell this software
+ * and its documentation for any purpose is hereby granted without
+ * fee, provided that the above copyright notice appear in all copies
+ * and that both that copyright notice and this permission notice
+ * appear in supporting documentation, and that the name of Red Hat
+ * not be used in advertising or publicity pertaining to distribution
+ * of the software without specific, written prior permission.  Red
+ * Hat makes no representations about the suitability of this software
+ * for any purpose.  It is provided "as is" without express or implied
+ * warranty.
+ *
+ * THE AUTHORS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS SOFTWARE,
+ * INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS, IN
+ * NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS
+ * OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT,
+ * NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "config.h"
+
+#include "libwacomint.h"
+
+#include <glib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+/* The cache is a single binary file holding a fully-parsed copy of the
+ * database. All references inside the file are offsets (for strings) or
+ * indices (for everything else) so the file can be used as-is wherever it
+ * is loaded. This also makes it usable as a read-only database image that
+ * is mapped into memory, see libwacom_database_new_from_image(). Only the
+ * strings are used in place, the structs are still built per process.
+ *
+ * Layout:
+ *   struct cache_header
+ *   struct cache_dir      dirs[ndirs]
+ *   struct cache_stylus   styli[nstyli]
+ *   struct cache_match    matches[nmatches]
+ *   struct cache_device   devices[ndevices]
+ *   int32_t               ints[nints]
+ *   char                  strings[strings_size]
+ *
+ * Every section starts 8-byte aligned. String offset 0 is NULL.
+ */
+
+#define CACHE_MAGIC "LWCACHE"
+#define CACHE_VERSION 2
+#define CACHE_BYTE_ORDER 0x01020304
+#define CACHE_NONE 0xffffffffU
+#define CACHE_NUM_BUTTONS 26 /* 'A' to 'Z' */
+
+struct cache_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t byte_order;
+	uint32_t header_size;
+	uint32_t file_size;
+	uint32_t ndirs;
+	uint32_t dirs;
+	uint32_t nstyli;
+	uint32_t styli;
+	uint32_t nmatches;
+	uint32_t matches;
+	uint32_t ndevices;
+	uint32_t devices;
+	uint32_t nints;
+	uint32_t ints;
+	uint32_t strings_size;
+	uint32_t strings;
+};
+
+struct cache_dir {
+	uint64_t signature;
+	uint32_t path;		/* where the directory is installed */
+	uint32_t padding;
+};
+
+struct cache_stylus {
+	int32_t id;
+	uint32_t name;
+	uint32_t group;
+	int32_t num_buttons;
+	uint32_t has_eraser;
+	uint32_t has_lens;
+	uint32_t has_wheel;
+	uint32_t eraser_type;
+	uint32_t type;
+	uint32_t axes;
+	uint32_t paired_ids;	/* index into ints */
+	uint32_t npaired_ids;
+};
+
+struct cache_match {
+	uint32_t match;
+	uint32_t name;
+	uint32_t bus;
+	uint32_t vendor_id;
+	uint32_t product_id;
+};
+
+struct cache_button {
+	uint32_t flags;
+	int32_t code;
+};
+
+struct cache_keycode {
+	uint32_t type;
+	uint32_t code;
+};
+
+struct cache_device {
+	uint32_t name;
+	uint32_t model_name;
+	uint32_t layout;	/* relative to layout_dir/layouts */
+	uint32_t layout_dir;	/* index into the data dirs or CACHE_NONE */
+	int32_t width;
+	int32_t height;
+	uint32_t cls;
+	int32_t num_strips;
+	uint32_t features;
+	uint32_t integration_flags;
+	int32_t strips_num_modes;
+	int32_t ring_num_modes;
+	int32_t ring2_num_modes;
+	uint32_t paired;	/* index into matches or CACHE_NONE */
+	uint32_t first_match;	/* index into matches */
+	uint32_t nmatches;
+	uint32_t default_match;	/* index into this device's matches */
+	uint32_t styli;		/* index into ints */
+	uint32_t nstyli;
+	uint32_t status_leds;	/* index into ints */
+	uint32_t nstatus_leds;
+	uint32_t buttons_mask;	/* bit n set if button 'A' + n exists */
+	uint32_t num_keycodes;
+	uint32_t padding;
+	struct cache_button buttons[CACHE_NUM_BUTTONS];
+	struct cache_keycode keycodes[32];
+};
+
+G_STATIC_ASSERT(sizeof(struct cache_header) % 8 == 0);
+G_STATIC_ASSERT(sizeof(((WacomDevice*)NULL)->keycodes) ==
+		sizeof(((struct cache_device*)NULL)->keycodes));
+
+struct cache_writer {
+	GArray *styli;		/* struct cache_stylus */
+	GArray *matches;	/* struct cache_match */
+	GArray *devices;	/* struct cache_device */
+	GArray *ints;		/* int32_t */
+	GArray *strings;	/* char */
+	GHashTable *string_offsets;
+};
+
+static uint32_t
+writer_add_string(struct cache_writer *w, const char *str)
+{
+	gpointer offset;
+
+	if (str == NULL)
+		return 0;
+
+	if (g_hash_table_lookup_extended(w->string_offsets, str, NULL, &offset))
+		return GPOINTER_TO_UINT(offset);
+
+	offset = GUINT_TO_POINTER(w->strings->len);
+	g_array_append_vals(w->strings, str, strlen(str) + 1);
+	g_hash_table_insert(w->string_offsets, (gpointer)str, offset);
+
+	return GPOINTER_TO_UINT(offset);
+}
+
+static uint32_t
+writer_add_ints(struct cache_writer *w, const int *values, guint count)
+{
+	uint32_t idx = w->ints->len;
+
+	if (count > 0)
+		g_array_append_vals(w->ints, values, count);
+
+	return idx;
+}
+
+static uint32_t
+writer_add_match(struct cache_writer *w, const WacomMatch *match)
+{
+	struct cache_match m = {
+		.match = writer_add_string(w, libwacom_match_get_match_string(match)),
+		.name = writer_add_string(w, libwacom_match_get_name(match)),
+		.bus = libwacom_match_get_bustype(match),
+		.vendor_id = libwacom_match_get_vendor_id(match),
+		.product_id = libwacom_match_get_product_id(match),
+	};
+
+	g_array_append_val(w->matches, m);
+
+	return w->matches->len - 1;
+}
+
+static gint
+stylus_id_compare(gconstpointer pa, gconstpointer pb)
+{
+	const WacomStylus *a = *(const WacomStylus **)pa,
+			  *b = *(const WacomStylus **)pb;
+
+	return a->id > b->id ? 1 : a->id == b->id ? 0 : -1;
+}
+
+static void
+writer_add_styli(struct cache_writer *w, const WacomDeviceDatabase *db)
+{
+	GHashTableIter iter;
+	gpointer value;
+	GArray *styli;
+
+	/* Sort by ID so the same database always gives us the same file */
+	styli = g_array_new(FALSE, FALSE, sizeof(WacomStylus*));
+	g_hash_table_iter_init(&iter, db->stylus_ht);
+	while (g_hash_table_iter_next(&iter, NULL, &value))
+		g_array_append_val(styli, value);
+	g_array_sort(styli, stylus_id_compare);
+
+	for (guint i = 0; i < styli->len; i++) {
+		const WacomStylus *stylus = g_array_index(styli, WacomStylus*, i);
+		struct cache_stylus s = {
+			.id = stylus->id,
+			.name = writer_add_string(w, stylus->name),
+			.group = writer_add_string(w, stylus->group),
+			.num_buttons = stylus->num_buttons,
+			.has_eraser = stylus->has_eraser,
+			.has_lens = stylus->has_lens,
+			.has_wheel = stylus->has_wheel,
+			.eraser_type = stylus->eraser_type,
+			.type = stylus->type,
+			.axes = stylus->axes,
+			.paired_ids = writer_add_ints(w, stylus->paired_ids,
+						      stylus->num_paired_ids),
+			.npaired_ids = stylus->num_paired_ids,
+		};
+
+		g_array_append_val(w->styli, s);
+	}
+
+	g_array_free(styli, TRUE);
+}
+
+static void
+writer_add_layout(struct cache_writer *w, struct cache_device *d,
+		  const char *layout, size_t ndirs, const char **datadirs)
+{
+	d->layout = 0;
+	d->layout_dir = CACHE_NONE;
+
+	if (!layout)
+		return;
+
+	/* Layouts are stored relative to their data directory so the cache
+	 * can be generated from a different location than the one it is
+	 * installed in */
+	for (size_t i = 0; i < ndirs; i++) {
+		char *prefix = g_build_filename(datadirs[i], "layouts", NULL);
+		size_t len = strlen(prefix);
+		bool found = g_str_has_prefix(layout, prefix) && layout[len] == '/';
+
+		g_free(prefix);
+		if (found) {
+			d->layout = writer_add_string(w, &layout[len + 1]);
+			d->layout_dir = i;
+			return;
+		}
+	}
+
+	d->layout = writer_add_string(w, layout);
+}
+
+static void
+writer_add_device(struct cache_writer *w, const WacomDevice *device,
+		  size_t ndirs, const char **datadirs)
+{
+	struct cache_device d = {0};
+
+	d.name = writer_add_string(w, device->name);
+	d.model_name = writer_add_string(w, device->model_name);
+	writer_add_layout(w, &d, device->layout, ndirs, datadirs);
+	d.width = device->width;
+	d.height = device->height;
+	d.cls = device->cls;
+	d.num_strips = device->num_strips;
+	d.features = device->features;
+	d.integration_flags = device->integration_flags;
+	d.strips_num_modes = device->strips_num_modes;
+	d.ring_num_modes = device->ring_num_modes;
+	d.ring2_num_modes = device->ring2_num_modes;
+	d.paired = device->paired ? writer_add_match(w, device->paired) : CACHE_NONE;
+
+	d.first_match = w->matches->len;
+	d.nmatches = device->num_matches;
+	d.default_match = 0;
+	for (int i = 0; i < device->num_matches; i++) {
+		const WacomMatch *m = device->matches[i];
+
+		writer_add_match(w, m);
+		if (m == device->match)
+			d.default_match = i;
+	}
+
+	d.styli = writer_add_ints(w, device->styli, device->num_styli);
+	d.nstyli = device->num_styli;
+	d.status_leds = writer_add_ints(w, (const int*)device->status_leds,
+					device->num_status_leds);
+	d.nstatus_leds = device->num_status_leds;
+
+	for (int i = 0; i < CACHE_NUM_BUTTONS; i++) {
+		const WacomButton *button = &device->buttons[i];
+
+		if (button->flags == WACOM_BUTTON_NONE)
+			continue;
+
+		d.buttons_mask |= 1U << i;
+		d.buttons[i].flags = button->flags;
+		d.buttons[i].code = button->code;
+	}
+
+	d.num_keycodes = device->num_keycodes;
+	for (size_t i = 0; i < device->num_keycodes; i++) {
+		d.keycodes[i].type = device->keycodes[i].type;
+		d.keycodes[i].code = device->keycodes[i].code;
+	}
+
+	g_array_append_val(w->devices, d);
+}
+
+static uint32_t
+append_section(GArray *out, const GArray *section)
+{
+	static const char zeroes[8] = {0};
+	uint32_t offset;
+
+	if (out->len % 8)
+		g_array_append_vals(out, zeroes, 8 - out->len % 8);
+
+	offset = out->len;
+	g_array_append_vals(out, section->data,
+			    section->len * g_array_get_element_size((GArray*)section));
+
+	return offset;
+}
+
+bool
+libwacom_cache_write(const WacomDeviceDatabase *db,
+		     size_t ndirs, const char **datadirs,
+		     const char **install_dirs,
+		     const char *path, WacomError *error)
+{
+	struct cache_writer w;
+	struct cache_header header = {
+		.magic = CACHE_MAGIC,
+		.version = CACHE_VERSION,
+		.byte_order = CACHE_BYTE_ORDER,
+		.header_size = sizeof(struct cache_header),
+	};
+	GArray *out, *dirs;
+	const WacomDevice * const *devices;
+	GError *gerror = NULL;
+	bool rc = false;
+
+	devices = libwacom_database_get_devices(db, NULL);
+
+	w.styli = g_array_new(FALSE, FALSE, sizeof(struct cache_stylus));
+	w.matches = g_array_new(FALSE, FALSE, sizeof(struct cache_match));
+	w.devices = g_array_new(FALSE, FALSE, sizeof(struct cache_device));
+	w.ints = g_array_new(FALSE, FALSE, sizeof(int32_t));
+	w.strings = g_array_new(FALSE, FALSE, sizeof(char));
+	w.string_offsets = g_hash_table_new(g_str_hash, g_str_equal);
+	dirs = g_array_new(FALSE, FALSE, sizeof(struct cache_dir));
+	out = g_array_new(FALSE, TRUE, sizeof(char));
+
+	/* offset 0 is the NULL string */
+	g_array_append_vals(w.strings, "", 1);
+
+	for (size_t i = 0; i < ndirs; i++) {
+		struct cache_dir dir = {0};
+
+		if (!libwacom_datadir_signature(datadirs[i], &dir.signature)) {
+			libwacom_error_set(error, WERROR_INVALID_PATH,
+					   "Failed to read data directory '%s'", datadirs[i]);
+			goto out;
+		}
+		dir.path = writer_add_string(&w, install_dirs ? install_dirs[i] : datadirs[i]);
+		g_array_append_val(dirs, dir);
+	}
+
+	writer_add_styli(&w, db);
+	for (const WacomDevice * const *d = devices; *d; d++)
+		writer_add_device(&w, *d, ndirs, datadirs);
+
+	g_array_set_size(out, sizeof(header));
+	header.ndirs = dirs->len;
+	header.dirs = append_section(out, dirs);
+	header.nstyli = w.styli->len;
+	header.styli = append_section(out, w.styli);
+	header.nmatches = w.matches->len;
+	header.matches = append_section(out, w.matches);
+	header.ndevices = w.devices->len;
+	header.devices = append_section(out, w.devices);
+	header.nints = w.ints->len;
+	header.ints = append_section(out, w.ints);
+	header.strings_size = w.strings->len;
+	header.strings = append_section(out, w.strings);
+	header.file_size = out->len;
+	memcpy(out->data, &header, sizeof(header));
+
+	if (!g_file_set_contents(path, out->data, out->len, &gerror)) {
+		libwacom_error_set(error, WERROR_BAD_ACCESS, "%s", gerror->message);
+		g_error_free(gerror);
+		goto out;
+	}
+
+	rc = true;
+out:
+	g_array_free(w.styli, TRUE);
+	g_array_free(w.matches, TRUE);
+	g_array_free(w.devices, TRUE);
+	g_array_free(w.ints, TRUE);
+	g_array_free(w.strings, TRUE);
+	g_hash_table_destroy(w.string_offsets);
+	g_array_free(dirs, TRUE);
+	g_array_free(out, TRUE);
+
+	return rc;
+}
+
+struct cache_reader {
+	const char *data;
+	GMappedFile *image;	/* NULL if strings must be copied */
+	bool embedded;		/* compiled into the library, strings are used in place */
+	struct arena *arena; /* where strings are copied to */
+	const struct cache_header *header;
+	const struct cache_dir *dirs;
+	const struct cache_stylus *styli;
+	const struct cache_match *matches;
+	const struct cache_device *devices;
+	const int32_t *ints;
+	const char *strings;
+};
+
+static bool
+section_is_valid(const struct cache_header *header, uint32_t offset,
+		 uint32_t count, size_t size)
+{
+	if (offset % 8 || offset < sizeof(*header) || offset > header->file_size)
+		return false;
+
+	return count <= (header->file_size - offset) / size;
+}
+
+static bool
+reader_init(struct cache_reader *r, const char *data, size_t len)
+{
+	const struct cache_header *h = (const struct cache_header*)data;
+
+	if (len < sizeof(*h) ||
+	    memcmp(h->magic, CACHE_MAGIC, sizeof(h->magic)) != 0 ||
+	    h->version != CACHE_VERSION ||
+	    h->byte_order != CACHE_BYTE_ORDER ||
+	    h->header_size != sizeof(*h) ||
+	    h->file_size != len)
+		return false;
+
+	if (!section_is_valid(h, h->dirs, h->ndirs, sizeof(struct cache_dir)) ||
+	    !section_is_valid(h, h->styli, h->nstyli, sizeof(struct cache_stylus)) ||
+	    !section_is_valid(h, h->matches, h->nmatches, sizeof(struct cache_match)) ||
+	    !section_is_valid(h, h->devices, h->ndevices, sizeof(struct cache_device)) ||
+	    !section_is_valid(h, h->ints, h->nints, sizeof(int32_t)) ||
+	    !section_is_valid(h, h->strings, h->strings_size, sizeof(char)))
+		return false;
+
+	/* Every string offset is valid as long as the table is terminated */
+	if (h->strings_size == 0 || data[h->strings + h->strings_size - 1] != '\0')
+		return false;
+
+	r->data = data;
+	r->header = h;
+	r->dirs = (const struct cache_dir*)(data + h->dirs);
+	r->styli = (const struct cache_stylus*)(data + h->styli);
+	r->matches = (const struct cache_match*)(data + h->matches);
+	r->devices = (const struct cache_device*)(data + h->devices);
+	r->ints = (const int32_t*)(data + h->ints);
+	r->strings = data + h->strings;
+
+	for (uint32_t i = 0; i < h->ndirs; i++) {
+		if (r->dirs[i].path == 0 || r->dirs[i].path >= h->strings_size)
+			return false;
+	}
+
+	return true;
+}
+
+static inline bool
+reader_string(const struct cache_reader *r, uint32_t offset, const char **str)
+{
+	if (offset >= r->header->strings_size)
+		return false;
+
+	*str = offset ? &r->strings[offset] : NULL;
+	return true;
+}
+
+/* Strings in an image are used in place, the image outlives every object
+ * referencing it. So does the embedded database. Otherwise they are
+ * interned in the database's arena. */
+static inline char *
+reader_dup(const struct cache_reader *r, const char *str)
+{
+	return (r->image || r->embedded) ? (char *)str : libwacom_arena_intern(r->arena, str);
+}
+
+static inline GMappedFile *
+reader_ref_image(const struct cache_reader *r)
+{
+	return r->image ? g_mapped_file_ref(r->image) : NULL;
+}
+
+/* Objects referencing the image are on the heap, otherwise they are
+ * allocated from the database's arena */
+static inline void *
+reader_alloc0(const struct cache_reader *r, size_t size)
+{
+	return r->image ? g_malloc0(size) : libwacom_arena_alloc0(r->arena, size);
+}
+
+static inline struct arena *
+reader_ref_arena(const struct cache_reader *r)
+{
+	return r->image ? NULL : libwacom_arena_ref(r->arena);
+}
+
+/* ints must have room for count values */
+static inline bool
+reader_ints(const struct cache_reader *r, uint32_t idx, uint32_t count, int *ints)
+{
+	if (idx > r->header->nints || count > r->header->nints - idx)
+		return false;
+
+	if (count > 0)
+		memcpy(ints, &r->ints[idx], count * sizeof(*ints));
+	return true;
+}
+
+static WacomMatch *
+reader_match(const struct cache_reader *r, uint32_t idx)
+{
+	const struct cache_match *m;
+	const char *name;
+	WacomMatch *match;
+
+	if (idx >= r->header->nmatches)
+		return NULL;
+
+	m = &r->matches[idx];
+	if (!reader_string(r, m->name, &name))
+		return NULL;
+
+	/* Only the generic match has no bus, make_match_string() can't
+	 * handle anything else */
+	switch (m->bus) {
+	case WBUSTYPE_USB:
+	case WBUSTYPE_SERIAL:
+	case WBUSTYPE_BLUETOOTH:
+	case WBUSTYPE_I2C:
+		break;
+	case WBUSTYPE_UNKNOWN:
+		if (!name && m->vendor_id == 0 && m->product_id == 0)
+			break;
+		/* fallthrough */
+	default:
+		return NULL;
+	}
+
+	if (r->image || r->embedded) {
+		if (m->match == 0 || m->match >= r->header->strings_size)
+			return NULL;
+
+		match = reader_alloc0(r, sizeof(*match));
+		match->refcnt = 1;
+		match->match = (char *)&r->strings[m->match];
+		match->name = (char *)name;
+		match->bus = m->bus;
+		match->vendor_id = m->vendor_id;
+		match->product_id = m->product_id;
+		match->image = reader_ref_image(r);
+		match->arena = reader_ref_arena(r);
+		libwacom_match_update_hash(match);
+		return match;
+	}
+
+	match = libwacom_match_new(r->arena, name, m->bus, m->vendor_id, m->product_id);
+	if (m->match == 0 || m->match >= r->header->strings_size ||
+	    !g_str_equal(match->match, &r->strings[m->match]))
+		match = libwacom_match_unref(match);
+
+	return match;
+}
+
+static WacomStylus *
+reader_stylus(const struct cache_reader *r, const struct cache_stylus *s)
+{
+	WacomStylus *stylus;
+	const char *name, *group;
+
+	if (!reader_string(r, s->name, &name) ||
+	    !reader_string(r, s->group, &group) ||
+	    s->npaired_ids > r->header->nints)
+		return NULL;
+
+	stylus = reader_alloc0(r, sizeof(*stylus));
+	stylus->refcnt = 1;
+	stylus->id = s->id;
+	stylus->name = reader_dup(r, name);
+	stylus->group = reader_dup(r, group);
+	stylus->image = reader_ref_image(r);
+	stylus->arena = reader_ref_arena(r);
+	stylus->num_buttons = s->num_buttons;
+	stylus->has_eraser = s->has_eraser;
+	stylus->has_lens = s->has_lens;
+	stylus->has_wheel = s->has_wheel;
+	stylus->eraser_type = s->eraser_type;
+	stylus->type = s->type;
+	stylus->axes = s->axes;
+	stylus->paired_ids = reader_alloc0(r, s->npaired_ids * sizeof(int));
+	stylus->num_paired_ids = s->npaired_ids;
+	if (!reader_ints(r, s->paired_ids, s->npaired_ids, stylus->paired_ids))
+		stylus = libwacom_stylus_unref(stylus);
+
+	return stylus;
+}
+
+static WacomDevice *
+reader_device(const struct cache_reader *r, const struct cache_device *d,
+	      const char **datadirs)
+{
+	WacomDevice *device;
+	const char *name, *model_name, *layout;
+
+	if (!reader_string(r, d->name, &name) ||
+	    !reader_string(r, d->model_name, &model_name) ||
+	    !reader_string(r, d->layout, &layout) ||
+	    (d->layout_dir != CACHE_NONE && d->layout_dir >= r->header->ndirs) ||
+	    d->nmatches == 0 || d->default_match >= d->nmatches ||
+	    d->num_keycodes > G_N_ELEMENTS(device->keycodes) ||
+	    d->nstatus_leds > G_N_ELEMENTS(device->status_leds) ||
+	    d->nstyli > r->header->nints)
+		return NULL;
+
+	device = reader_alloc0(r, sizeof(*device));
+	device->refcnt = 1;
+	device->name = reader_dup(r, name);
+	device->model_name = reader_dup(r, model_name);
+	device->image = reader_ref_image(r);
+	device->arena = reader_ref_arena(r);
+	if (layout && d->layout_dir != CACHE_NONE) {
+		const char *dir = datadirs ? datadirs[d->layout_dir] :
+				  &r->strings[r->dirs[d->layout_dir].path];
+		device->layout = g_build_filename(dir, "layouts", layout, NULL);
+	} else
+		device->layout = g_strdup(layout);
+	if (device->arena)
+		device->layout = libwacom_arena_take(device->arena, device->layout);
+	device->width = d->width;
+	device->height = d->height;
+	device->cls = d->cls;
+	device->num_strips = d->num_strips;
+	device->features = d->features;
+	device->integration_flags = d->integration_flags;
+	device->strips_num_modes = d->strips_num_modes;
+	device->ring_num_modes = d->ring_num_modes;
+	device->ring2_num_modes = d->ring2_num_modes;
+
+	for (uint32_t i = 0; i < d->nmatches; i++) {
+		WacomMatch *m = reader_match(r, d->first_match + i);
+
+		if (!m)
+			goto error;
+		libwacom_add_match(device, m);
+		if (i == d->default_match)
+			libwacom_set_default_match(device, m);
+		libwacom_match_unref(m);
+	}
+	if (!device->match)
+		goto error;
+
+	if (d->paired != CACHE_NONE) {
+		device->paired = reader_match(r, d->paired);
+		if (!device->paired)
+			goto error;
+	}
+
+	device->styli = reader_alloc0(r, d->nstyli * sizeof(int));
+	device->num_styli = d->nstyli;
+	device->num_status_leds = d->nstatus_leds;
+	if (!reader_ints(r, d->styli, d->nstyli, device->styli) ||
+	    !reader_ints(r, d->status_leds, d->nstatus_leds, (int *)device->status_leds))
+		goto error;
+
+	for (int i = 0; i < CACHE_NUM_BUTTONS; i++) {
+		if (!(d->buttons_mask & (1U << i)))
+			continue;
+
+		device->buttons[i].flags = d->buttons[i].flags;
+		device->buttons[i].code = d->buttons[i].code;
+		device->num_buttons++;
+	}
+
+	device->num_keycodes = d->num_keycodes;
+	for (size_t i = 0; i < d->num_keycodes; i++) {
+		device->keycodes[i].type = d->keycodes[i].type;
+		device->keycodes[i].code = d->keycodes[i].code;
+	}
+
+	libwacom_update_hash(device);
+
+	return device;
+
+error:
+	return libwacom_unref(device);
+}
+
+static bool
+reader_load_styli(const struct cache_reader *r, WacomDeviceDatabase *db)
+{
+	for (uint32_t i = 0; i < r->header->nstyli; i++) {
+		WacomStylus *stylus = reader_stylus(r, &r->styli[i]);
+
+		if (!stylus)
+			return false;
+
+		g_hash_table_insert(db->stylus_ht, GINT_TO_POINTER(stylus->id), stylus);
+	}
+
+	return true;
+}
+
+/* If datadirs is NULL, layouts are looked up in the directories recorded
+ * in the cache. Matches already in the database take precedence, like
+ * they do for data files in an earlier directory. */
+static bool
+reader_load_devices(const struct cache_reader *r, WacomDeviceDatabase *db,
+		    const char **datadirs)
+{
+	for (uint32_t i = 0; i < r->header->ndevices; i++) {
+		WacomDevice *device = reader_device(r, &r->devices[i], datadirs);
+		int m = 0;
+
+		if (!device)
+			return false;
+
+		/* Note: we may change the array while iterating over it */
+		while (m < device->num_matches) {
+			WacomMatch *match = device->matches[m];
+			const char *matchstr = libwacom_match_get_match_string(match);
+
+			if (g_hash_table_contains(db->device_ht, matchstr)) {
+				/* Nothing left to add */
+				if (device->num_matches == 1)
+					break;
+				libwacom_remove_match(device, match);
+				continue;
+			}
+
+			libwacom_database_add_device(db, matchstr, match,
+						     libwacom_ref(device));
+			m++;
+		}
+		libwacom_unref(device);
+	}
+
+	return true;
+}
+
+static bool
+reader_load(const struct cache_reader *r, WacomDeviceDatabase *db,
+	    const char **datadirs)
+{
+	return reader_load_styli(r, db) && reader_load_devices(r, db, datadirs);
+}
+
+bool
+libwacom_cache_load(WacomDeviceDatabase *db, const char *path,
+		    size_t ndirs, const char **datadirs)
+{
+	struct cache_reader r = {0};
+	char *data = NULL;
+	gsize len;
+	bool rc = false;
+
+	if (!g_file_get_contents(path, &data, &len, NULL))
+		return false;
+
+	if (!reader_init(&r, data, len)) {
+		g_warning("Ignoring invalid database cache '%s'", path);
+		goto out;
+	}
+
+	/* A cache for a different set of directories is simply stale */
+	if (r.header->ndirs != ndirs)
+		goto out;
+
+	for (size_t i = 0; i < ndirs; i++) {
+		uint64_t signature;
+
+		if (!libwacom_datadir_signature(datadirs[i], &signature) ||
+		    signature != r.dirs[i].signature)
+			goto out;
+	}
+
+	r.arena = db->arena;
+	rc = reader_load(&r, db, datadirs);
+	if (!rc) {
+		g_warning("Ignoring invalid database cache '%s'", path);
+		libwacom_database_clear(db);
+	}
+
+out:
+	g_free(data);
+	return rc;
+}
+
+static bool
+reader_init_embedded(struct cache_reader *r, WacomDeviceDatabase *db)
+{
+	const char *data;
+	size_t len;
+
+	data = libwacom_embedded_image(&len);
+	if (!data)
+		return false;
+
+	if (!reader_init(r, data, len)) {
+		g_warning("Invalid embedded database");
+		return false;
+	}
+	r->embedded = true;
+	r->arena = db->arena;
+
+	return true;
+}
+
+/* The embedded database is loaded in two steps so data files can be
+ * layered on top of it in the order libwacom_database_new_for_paths()
+ * uses: all styli before the tablets that refer to them. */
+bool
+libwacom_cache_load_embedded_styli(WacomDeviceDatabase *db)
+{
+	struct cache_reader r = {0};
+
+	return reader_init_embedded(&r, db) && reader_load_styli(&r, db);
+}
+
+bool
+libwacom_cache_load_embedded_devices(WacomDeviceDatabase *db)
+{
+	struct cache_reader r = {0};
+
+	return reader_init_embedded(&r, db) && reader_load_devices(&r, db, NULL);
+}
+
+LIBWACOM_EXPORT WacomDeviceDatabase *
+libwacom_database_new_from_image(const char *path)
+{
+	WacomDeviceDatabase *db;
+	GMappedFile *image;
+	struct cache_reader r = {0};
+
+	image = g_mapped_file_new(path, FALSE, NULL);
+	if (!image)
+		return NULL;
+
+	if (!reader_init(&r, g_mapped_file_get_contents(image),
+			 g_mapped_file_get_length(image))) {
+		g_warning("Invalid database image '%s'", path);
+		g_mapped_file_unref(image);
+		return NULL;
+	}
+	r.image = image;
+
+	db = libwacom_database_alloc(image);
+	if (!reader_load(&r, db, NULL)) {
+		g_warning("Invalid database image '%s'", path);
+		libwacom_database_destroy(db);
+		db = NULL;
+	}
+
+	g_mapped_file_unref(image);
+
+	return db;
+}
+
+/* vim: set noexpandtab tabstop=8 shiftwidth=8: */
@@ -35,10 +35,16 @@
 #include <assert.h>
 #include <glib.h>
 #include <dirent.h>
+#include <fcntl.h>
 #include <string.h>
+#include <sys/stat.h>
+#if HAVE_SYS_INOTIFY_H
+#include <sys/inotify.h>
+#endif
 #include <stdbool.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <unistd.h>
 
 #define TABLET_SUFFIX ".tablet"
 #define STYLUS_SUFFIX ".stylus"
@@ -183,7 +189,7 @@ match_from_string(const char *str, WacomBusType *bus, int *vendor_id, int *produ
 }
 
 static WacomMatch *
-libwacom_match_from_string(const char *matchstr)
+libwacom_match_from_string(struct arena *arena, const char *matchstr)
 {
 	char *name = NULL;
 	int vendor_id, product_id;
@@ -203,14 +209,15 @@ libwacom_match_from_string(const char *matchstr)
 		return NULL;
 	}
 
-	match = libwacom_match_new(name, bus, vendor_id, product_id);
+	match = libwacom_match_new(arena, name, bus, vendor_id, product_id);
 	free(name);
 
 	return match;
 }
 
 static gboolean
-libwacom_matchstr_to_paired(WacomDevice *device, const char *matchstr)
+libwacom_matchstr_to_paired(WacomDevice *device, struct arena *arena,
+			    const char *matchstr)
 {
 	char *name = NULL;
 	int vendor_id, product_id;
@@ -223,124 +230,127 @@ libwacom_matchstr_to_paired(WacomDevice *device, const char *matchstr)
 		return FALSE;
 	}
 
-	device->paired = libwacom_match_new(name, bus, vendor_id, product_id);
+	device->paired = libwacom_match_new(arena, name, bus, vendor_id, product_id);
 
 	free(name);
 	return TRUE;
 }
 
 static void
-libwacom_parse_stylus_keyfile(WacomDeviceDatabase *db, const char *path)
+add_stylus(GHashTable *stylus_ht, WacomStylus *stylus)
 {
-	GKeyFile *keyfile;
+	if (g_hash_table_lookup (stylus_ht, GINT_TO_POINTER (stylus->id)) != NULL)
+		g_warning ("Duplicate definition for stylus ID '%#x'", stylus->id);
+
+	g_hash_table_insert (stylus_ht, GINT_TO_POINTER (stylus->id), stylus);
+}
+
+/* Only warns about invalid values, a missing key is false */
+static gboolean
+libwacom_parse_stylus_boolean(const WacomStylus *stylus,
+			      const struct keyfile_section *section,
+			      enum keyfile_key key)
+{
+	bool value;
+
+	if (!libwacom_keyfile_get_boolean(section, key, &value) && section->values[key])
+		g_warning ("Stylus %s (%s) Value “%s” cannot be interpreted as a boolean.\n",
+			   stylus->name, section->name, section->values[key]);
+
+	return value;
+}
+
+static void
+libwacom_parse_stylus_keyfile(struct arena *arena, GHashTable *stylus_ht,
+			      const char *path)
+{
+	struct keyfile keyfile;
 	GError *error = NULL;
-	char **groups;
 	gboolean rc;
 	guint i;
 
-	keyfile = g_key_file_new();
-
-	rc = g_key_file_load_from_file(keyfile, path, G_KEY_FILE_NONE, &error);
+	rc = libwacom_keyfile_load(&keyfile, path, &error);
 	g_assert (rc);
-	groups = g_key_file_get_groups (keyfile, NULL);
-	for (i = 0; groups[i]; i++) {
+	for (i = 0; i < keyfile.sections->len; i++) {
+		const struct keyfile_section *section;
+		const char *group;
 		WacomStylus *stylus;
-		GError *error = NULL;
-		char *type;
+		char *cursor, *item;
 		int id;
-		char **string_list;
 
-		if (!safe_atoi_base (groups[i], &id, 16)) {
-			g_warning ("Failed to parse stylus ID '%s'", groups[i]);
+		section = &g_array_index(keyfile.sections, struct keyfile_section, i);
+		group = section->name;
+		if (!safe_atoi_base (group, &id, 16)) {
+			g_warning ("Failed to parse stylus ID '%s'", group);
 			continue;
 		}
 
-		stylus = g_new0 (WacomStylus, 1);
+		stylus = libwacom_arena_alloc0(arena, sizeof(*stylus));
 		stylus->refcnt = 1;
 		stylus->id = id;
-		stylus->name = g_key_file_get_string(keyfile, groups[i], "Name", NULL);
-		stylus->group = g_key_file_get_string(keyfile, groups[i], "Group", NULL);
-
-		type = g_key_file_get_string(keyfile, groups[i], "EraserType", NULL);
-		stylus->eraser_type = eraser_type_from_str (type);
-		g_free (type);
-
-		string_list = g_key_file_get_string_list (keyfile, groups[i], "PairedStylusIds", NULL, NULL);
-		stylus->paired_ids = g_array_new (FALSE, FALSE, sizeof(int));
-		if (string_list) {
-			guint j;
-
-			for (j = 0; string_list[j]; j++) {
+		stylus->arena = libwacom_arena_ref(arena);
+		stylus->name = libwacom_arena_intern(arena,
+						     libwacom_keyfile_get_string(section, KF_NAME));
+		stylus->group = libwacom_arena_intern(arena,
+						      libwacom_keyfile_get_string(section, KF_GROUP));
+
+		stylus->eraser_type = eraser_type_from_str (libwacom_keyfile_get_string(section, KF_ERASER_TYPE));
+
+		cursor = libwacom_keyfile_get_list(section, KF_PAIRED_STYLUS_IDS);
+		if (cursor) {
+			stylus->paired_ids = libwacom_arena_alloc0(arena,
+								   libwacom_keyfile_list_max_length(cursor) * sizeof(int));
+			while ((item = libwacom_keyfile_list_next(&cursor))) {
 				int val;
 
-				if (safe_atoi_base (string_list[j], &val, 16)) {
-					g_array_append_val (stylus->paired_ids, val);
+				if (safe_atoi_base (item, &val, 16)) {
+					stylus->paired_ids[stylus->num_paired_ids++] = val;
 				} else {
-					g_warning ("Stylus %s (%s) Ignoring invalid PairedId value\n", stylus->name, groups[i]);
+					g_warning ("Stylus %s (%s) Ignoring invalid PairedId value\n", stylus->name, group);
 				}
 			}
-
-			g_strfreev (string_list);
 		}
 
-		stylus->has_lens = g_key_file_get_boolean(keyfile, groups[i], "HasLens", &error);
-		if (error && error->code == G_KEY_FILE_ERROR_INVALID_VALUE)
-			g_warning ("Stylus %s (%s) %s\n", stylus->name, groups[i], error->message);
-		g_clear_error (&error);
-		stylus->has_wheel = g_key_file_get_boolean(keyfile, groups[i], "HasWheel", &error);
-		if (error && error->code == G_KEY_FILE_ERROR_INVALID_VALUE)
-			g_warning ("Stylus %s (%s) %s\n", stylus->name, groups[i], error->message);
-		g_clear_error (&error);
-
-		stylus->num_buttons = g_key_file_get_integer(keyfile, groups[i], "Buttons", &error);
-		if (stylus->num_buttons == 0 && error != NULL) {
+		stylus->has_lens = libwacom_parse_stylus_boolean(stylus, section, KF_HAS_LENS);
+		stylus->has_wheel = libwacom_parse_stylus_boolean(stylus, section, KF_HAS_WHEEL);
+
+		if (!libwacom_keyfile_get_integer(section, KF_BUTTONS, &stylus->num_buttons))
 			stylus->num_buttons = -1;
-			g_clear_error (&error);
-		}
 
-		string_list = g_key_file_get_string_list (keyfile, groups[i], "Axes", NULL, NULL);
-		if (string_list) {
+		cursor = libwacom_keyfile_get_list(section, KF_AXES);
+		if (cursor) {
 			WacomAxisTypeFlags axes = WACOM_AXIS_TYPE_NONE;
-			guint j;
 
-			for (j = 0; string_list[j]; j++) {
+			while ((item = libwacom_keyfile_list_next(&cursor))) {
 				WacomAxisTypeFlags flag = WACOM_AXIS_TYPE_NONE;
-				if (g_str_equal(string_list[j], "Tilt")) {
+				if (g_str_equal(item, "Tilt")) {
 					flag = WACOM_AXIS_TYPE_TILT;
-				} else if (g_str_equal(string_list[j], "RotationZ")) {
+				} else if (g_str_equal(item, "RotationZ")) {
 					flag = WACOM_AXIS_TYPE_ROTATION_Z;
-				} else if (g_str_equal(string_list[j], "Distance")) {
+				} else if (g_str_equal(item, "Distance")) {
 					flag = WACOM_AXIS_TYPE_DISTANCE;
-				} else if (g_str_equal(string_list[j], "Pressure")) {
+				} else if (g_str_equal(item, "Pressure")) {
 					flag = WACOM_AXIS_TYPE_PRESSURE;
-				} else if (g_str_equal(string_list[j], "Slider")) {
+				} else if (g_str_equal(item, "Slider")) {
 					flag = WACOM_AXIS_TYPE_SLIDER;
 				} else {
 					g_warning ("Invalid axis %s for stylus ID %s\n",
-						   string_list[j], groups[i]);
+						   item, group);
 				}
 				if (axes & flag)
 					g_warning ("Duplicate axis %s for stylus ID %s\n",
-						   string_list[j], groups[i]);
+						   item, group);
 				axes |= flag;
 			}
 
 			stylus->axes = axes;
-			g_strfreev (string_list);
 		}
 
-		type = g_key_file_get_string(keyfile, groups[i], "Type", NULL);
-		stylus->type = type_from_str (type);
-		g_free (type);
+		stylus->type = type_from_str (libwacom_keyfile_get_string(section, KF_TYPE));
 
-		if (g_hash_table_lookup (db->stylus_ht, GINT_TO_POINTER (id)) != NULL)
-			g_warning ("Duplicate definition for stylus ID '%#x'", id);
-
-		g_hash_table_insert (db->stylus_ht, GINT_TO_POINTER (id), stylus);
+		add_stylus (stylus_ht, stylus);
 	}
-	g_strfreev (groups);
-	if (keyfile)
-		g_key_file_free (keyfile);
+	libwacom_keyfile_release(&keyfile);
 }
 
 static void
@@ -374,17 +384,18 @@ libwacom_setup_paired_attributes(WacomDeviceDatabase *db)
 
 static const struct {
 	const char       *key;
+	enum keyfile_key  id;
 	WacomButtonFlags  flag;
 } options[] = {
-	{ "Left", WACOM_BUTTON_POSITION_LEFT },
-	{ "Right", WACOM_BUTTON_POSITION_RIGHT },
-	{ "Top", WACOM_BUTTON_POSITION_TOP },
-	{ "Bottom", WACOM_BUTTON_POSITION_BOTTOM },
-	{ "Ring", WACOM_BUTTON_RING_MODESWITCH },
-	{ "Ring2", WACOM_BUTTON_RING2_MODESWITCH },
-	{ "Touchstrip", WACOM_BUTTON_TOUCHSTRIP_MODESWITCH },
-	{ "Touchstrip2", WACOM_BUTTON_TOUCHSTRIP2_MODESWITCH },
-	{ "OLEDs", WACOM_BUTTON_OLED }
+	{ "Left", KF_LEFT, WACOM_BUTTON_POSITION_LEFT },
+	{ "Right", KF_RIGHT, WACOM_BUTTON_POSITION_RIGHT },
+	{ "Top", KF_TOP, WACOM_BUTTON_POSITION_TOP },
+	{ "Bottom", KF_BOTTOM, WACOM_BUTTON_POSITION_BOTTOM },
+	{ "Ring", KF_RING, WACOM_BUTTON_RING_MODESWITCH },
+	{ "Ring2", KF_RING2, WACOM_BUTTON_RING2_MODESWITCH },
+	{ "Touchstrip", KF_TOUCHSTRIP, WACOM_BUTTON_TOUCHSTRIP_MODESWITCH },
+	{ "Touchstrip2", KF_TOUCHSTRIP2, WACOM_BUTTON_TOUCHSTRIP2_MODESWITCH },
+	{ "OLEDs", KF_OLEDS, WACOM_BUTTON_OLED }
 };
 
 static const struct {
@@ -406,62 +417,49 @@ static const struct {
 };
 
 static void
-libwacom_parse_buttons_key(WacomDevice      *device,
-			   GKeyFile         *keyfile,
-			   const char       *key,
-			   WacomButtonFlags  flag)
+libwacom_parse_buttons_key(WacomDevice                  *device,
+			   const struct keyfile_section *section,
+			   enum keyfile_key              id,
+			   const char                   *key,
+			   WacomButtonFlags              flag)
 {
-	guint i;
-	char **vals;
+	char *cursor = libwacom_keyfile_get_list(section, id);
+	char *item;
 
-	vals = g_key_file_get_string_list (keyfile, BUTTONS_GROUP, key, NULL, NULL);
-	if (vals == NULL)
-		return;
-	for (i = 0; vals[i] != NULL; i++) {
+	while ((item = libwacom_keyfile_list_next(&cursor))) {
 		char val;
 		WacomButton *button;
 
-		val = *vals[i];
-		if (strlen (vals[i]) > 1 ||
+		val = *item;
+		if (strlen (item) > 1 ||
 		    val < 'A' ||
 		    val > 'Z') {
-			g_warning ("Ignoring value '%s' in key '%s'", vals[i], key);
+			g_warning ("Ignoring value '%s' in key '%s'", item, key);
 			continue;
 		}
 
-		button = g_hash_table_lookup(device->buttons, GINT_TO_POINTER(val));
-		if (!button) {
-			button = g_new0(WacomButton, 1);
-			g_hash_table_insert(device->buttons, GINT_TO_POINTER(val), button);
-		}
+		button = &device->buttons[val - 'A'];
+		if (button->flags == WACOM_BUTTON_NONE)
+			device->num_buttons++;
 
 		button->flags |= flag;
 	}
-
-	g_strfreev (vals);
-}
-
-static void
-reset_code(gpointer key, gpointer value, gpointer user_data)
-{
-	WacomButton *button = value;
-	button->code = 0;
 }
 
 static inline bool
-set_button_codes_from_string(WacomDevice *device, char **strvals)
+set_button_codes_from_string(WacomDevice *device, char *strvals)
 {
 	bool success = false;
 
 	assert(strvals);
 
-	for (guint i = 0; i < g_hash_table_size(device->buttons); i++) {
+	for (int i = 0; i < device->num_buttons; i++) {
 		char key = 'A' + i;
 		int code = -1;
-		WacomButton *button = g_hash_table_lookup(device->buttons, GINT_TO_POINTER(key));
-		const char *str = strvals[i];
+		WacomButton *button = &device->buttons[i];
+		const char *str = libwacom_keyfile_list_next(&strvals);
 
-		if (!button) {
+		if (button->flags == WACOM_BUTTON_NONE) {
 			g_error("%s: Button %c is not defined, ignoring all codes\n",
 				device->name, key);
 			goto out;
@@ -488,20 +486,22 @@ set_button_codes_from_string(WacomDevice *device, char **strvals)
 	success = true;
 
 out:
-	if (!success)
-		g_hash_table_foreach(device->buttons, reset_code, NULL);
+	if (!success) {
+		for (int i = 0; i < NUM_BUTTONS; i++)
+			device->buttons[i].code = 0;
+	}
 
 	return success;
 }
 
 static inline bool
-set_key_codes_from_string(WacomDevice *device, char **strvals)
+set_key_codes_from_string(WacomDevice *device, char *strvals)
 {
+	const char *str;
 	bool success = false;
 	assert(strvals);
 
-	for (unsigned int idx = 0; strvals[idx]; idx++) {
-		const char *str = strvals[idx];
+	for (unsigned int idx = 0; (str = libwacom_keyfile_list_next(&strvals)); idx++) {
 		int code = -1;
 		int type = -1;
 
@@ -516,7 +516,7 @@ set_key_codes_from_string(WacomDevice *device, char **strvals)
 			type = EV_SW;
 			code = libevdev_event_code_from_code_name(str);
 		} else {
-			if (safe_atoi_base (strvals[idx], &code, 16))
+			if (safe_atoi_base (str, &code, 16))
 				type = EV_KEY;
 		}
 
@@ -543,10 +543,9 @@ set_button_codes_from_heuristics(WacomDevice *device)
 {
 	for (char key = 'A'; key <= 'Z'; key++) {
 		int code = 0;
-		WacomButton *button;
+		WacomButton *button = &device->buttons[key - 'A'];
 
-		button = g_hash_table_lookup(device->buttons, GINT_TO_POINTER(key));
-		if (!button)
+		if (button->flags == WACOM_BUTTON_NONE)
 			continue;
 
 		if (device->cls == WCLASS_BAMBOO ||
@@ -594,36 +593,29 @@ set_button_codes_from_heuristics(WacomDevice *device)
 }
 
 static void
-libwacom_parse_button_codes(WacomDevice *device,
-			    GKeyFile    *keyfile)
+libwacom_parse_button_codes(WacomDevice                  *device,
+			    const struct keyfile_section *section)
 {
-	char **vals;
+	char *vals = libwacom_keyfile_get_list(section, KF_EVDEV_CODES);
 
-	vals = g_key_file_get_string_list(keyfile, BUTTONS_GROUP, "EvdevCodes", NULL, NULL);
 	if (!vals || !set_button_codes_from_string(device, vals))
 		set_button_codes_from_heuristics(device);
-
-	g_strfreev (vals);
 }
 
 static int
-libwacom_parse_num_modes (WacomDevice      *device,
-			  GKeyFile         *keyfile,
-			  const char       *key,
-			  WacomButtonFlags  flag)
+libwacom_parse_num_modes (WacomDevice                  *device,
+			  const struct keyfile_section *section,
+			  enum keyfile_key              key,
+			  WacomButtonFlags              flag)
 {
-	GHashTableIter iter;
 	int num;
-	gpointer k, v;
 
-	num = g_key_file_get_integer (keyfile, BUTTONS_GROUP, key, NULL);
+	libwacom_keyfile_get_integer (section, key, &num);
 	if (num > 0)
 		return num;
 
-	g_hash_table_iter_init(&iter, device->buttons);
-	while (g_hash_table_iter_next(&iter, &k, &v)) {
-		WacomButton *button = v;
-		if (button->flags & flag)
+	for (int i = 0; i < NUM_BUTTONS; i++) {
+		if (device->buttons[i].flags & flag)
 			num++;
 	}
 
@@ -631,45 +623,47 @@ libwacom_parse_num_modes (WacomDevice      *device,
 }
 
 static void
-libwacom_parse_buttons(WacomDevice *device,
-		       GKeyFile    *keyfile)
+libwacom_parse_buttons(WacomDevice           *device,
+		       const struct keyfile  *keyfile)
 {
+	const struct keyfile_section *section;
 	guint i;
 
-	if (!g_key_file_has_group(keyfile, BUTTONS_GROUP))
+	section = libwacom_keyfile_get_section(keyfile, BUTTONS_GROUP);
+	if (!section)
 		return;
 
 	for (i = 0; i < G_N_ELEMENTS (options); i++)
-		libwacom_parse_buttons_key(device, keyfile, options[i].key, options[i].flag);
+		libwacom_parse_buttons_key(device, section, options[i].id, options[i].key, options[i].flag);
 
-	libwacom_parse_button_codes(device, keyfile);
+	libwacom_parse_button_codes(device, section);
 
-	device->ring_num_modes = libwacom_parse_num_modes(device, keyfile, "RingNumModes", WACOM_BUTTON_RING_MODESWITCH);
-	device->ring2_num_modes = libwacom_parse_num_modes(device, keyfile, "Ring2NumModes", WACOM_BUTTON_RING2_MODESWITCH);
-	device->strips_num_modes = libwacom_parse_num_modes(device, keyfile, "StripsNumModes", WACOM_BUTTON_TOUCHSTRIP_MODESWITCH);
+	device->ring_num_modes = libwacom_parse_num_modes(device, section, KF_RING_NUM_MODES, WACOM_BUTTON_RING_MODESWITCH);
+	device->ring2_num_modes = libwacom_parse_num_modes(device, section, KF_RING2_NUM_MODES, WACOM_BUTTON_RING2_MODESWITCH);
+	device->strips_num_modes = libwacom_parse_num_modes(device, section, KF_STRIPS_NUM_MODES, WACOM_BUTTON_TOUCHSTRIP_MODESWITCH);
 }
 
 static void
-libwacom_parse_key_codes(WacomDevice *device,
-			 GKeyFile    *keyfile)
+libwacom_parse_key_codes(WacomDevice                  *device,
+			 const struct keyfile_section *section)
 {
-	char **vals;
+	char *vals = libwacom_keyfile_get_list(section, KF_KEY_CODES);
 
-	vals = g_key_file_get_string_list(keyfile, KEYS_GROUP, "KeyCodes", NULL, NULL);
 	if (vals)
 		set_key_codes_from_string(device, vals);
-
-	g_strfreev (vals);
 }
 
 static void
-libwacom_parse_keys(WacomDevice *device,
-		    GKeyFile    *keyfile)
+libwacom_parse_keys(WacomDevice           *device,
+		    const struct keyfile  *keyfile)
 {
-	if (!g_key_file_has_group(keyfile, KEYS_GROUP))
+	const struct keyfile_section *section;
+
+	section = libwacom_keyfile_get_section(keyfile, KEYS_GROUP);
+	if (!section)
 		return;
 
-	libwacom_parse_key_codes(device, keyfile);
+	libwacom_parse_key_codes(device, section);
 }
 
 
@@ -682,18 +676,16 @@ styli_id_sort(gconstpointer pa, gconstpointer pb)
 
 static void
 libwacom_parse_styli_list(WacomDeviceDatabase *db, WacomDevice *device,
-			  char **ids)
+			  char *ids)
 {
 	GArray *array;
-	guint i;
+	const char *id;
 
 	array = g_array_new (FALSE, FALSE, sizeof(int));
-	for (i = 0; ids[i]; i++) {
-		const char *id = ids[i];
-
+	while ((id = libwacom_keyfile_list_next(&ids))) {
 		if (g_str_has_prefix(id, "0x")) {
 			int int_value;
-			if (safe_atoi_base (ids[i], &int_value, 16)) {
+			if (safe_atoi_base (id, &int_value, 16)) {
 				g_array_append_val (array, int_value);
 			}
 		} else if (g_str_has_prefix(id, "@")) {
@@ -715,31 +707,42 @@ libwacom_parse_styli_list(WacomDeviceDatabase *db, WacomDevice *device,
 	/* Using groups means we don't get the styli in ascending order.
 	   Sort it so the output is predictable */
 	g_array_sort(array, styli_id_sort);
-	device->styli = array;
+	device->num_styli = array->len;
+	device->styli = libwacom_arena_memdup(db->arena, array->data,
+					      array->len * sizeof(int));
+	g_array_free(array, TRUE);
+}
+
+static inline bool
+has_feature(const struct keyfile_section *section, enum keyfile_key key)
+{
+	bool value;
+
+	return libwacom_keyfile_get_boolean(section, key, &value) && value;
 }
 
 static void
-libwacom_parse_features(WacomDevice *device, GKeyFile *keyfile)
+libwacom_parse_features(WacomDevice *device, const struct keyfile_section *section)
 {
-	char **string_list;
+	char *cursor, *item;
 
 	/* Features */
-	if (g_key_file_get_boolean(keyfile, FEATURES_GROUP, "Stylus", NULL))
+	if (has_feature(section, KF_STYLUS))
 		device->features |= FEATURE_STYLUS;
 
-	if (g_key_file_get_boolean(keyfile, FEATURES_GROUP, "Touch", NULL))
+	if (has_feature(section, KF_TOUCH))
 		device->features |= FEATURE_TOUCH;
 
-	if (g_key_file_get_boolean(keyfile, FEATURES_GROUP, "Ring", NULL))
+	if (has_feature(section, KF_RING))
 		device->features |= FEATURE_RING;
 
-	if (g_key_file_get_boolean(keyfile, FEATURES_GROUP, "Ring2", NULL))
+	if (has_feature(section, KF_RING2))
 		device->features |= FEATURE_RING2;
 
-	if (g_key_file_get_boolean(keyfile, FEATURES_GROUP, "Reversible", NULL))
+	if (has_feature(section, KF_REVERSIBLE))
 		device->features |= FEATURE_REVERSIBLE;
 
-	if (g_key_file_get_boolean(keyfile, FEATURES_GROUP, "TouchSwitch", NULL))
+	if (has_feature(section, KF_TOUCH_SWITCH))
 		device->features |= FEATURE_TOUCHSWITCH;
 
 	if (device->integration_flags != WACOM_DEVICE_INTEGRATED_UNSET &&
@@ -755,21 +758,24 @@ libwacom_parse_features(WacomDevice *device, GKeyFile *keyfile)
 	    (device->features & FEATURE_TOUCHSWITCH))
 		g_warning ("Tablet '%s' has touch switch but no touch tool. This is impossible", libwacom_get_match(device));
 
-	device->num_strips = g_key_file_get_integer(keyfile, FEATURES_GROUP, "NumStrips", NULL);
+	libwacom_keyfile_get_integer(section, KF_NUM_STRIPS, &device->num_strips);
 
-	string_list = g_key_file_get_string_list(keyfile, FEATURES_GROUP, "StatusLEDs", NULL, NULL);
-	if (string_list) {
-		guint i, n;
+	cursor = libwacom_keyfile_get_list(section, KF_STATUS_LEDS);
+	while ((item = libwacom_keyfile_list_next(&cursor))) {
+		guint n;
 
-		for (i = 0; string_list[i]; i++) {
-			for (n = 0; n < G_N_ELEMENTS (supported_leds); n++) {
-				if (g_str_equal(string_list[i], supported_leds[n].key)) {
-					g_array_append_val (device->status_leds, supported_leds[n].value);
-					break;
-				}
+		for (n = 0; n < G_N_ELEMENTS (supported_leds); n++) {
+			if (!g_str_equal(item, supported_leds[n].key))
+				continue;
+
+			if (device->num_status_leds == NUM_STATUS_LEDS) {
+				g_warning ("Tablet '%s' has too many StatusLEDs, ignoring '%s'",
+					   libwacom_get_match(device), item);
+				break;
 			}
+			device->status_leds[device->num_status_leds++] = supported_leds[n].value;
+			break;
 		}
-		g_strfreev (string_list);
 	}
 }
 
@@ -779,42 +785,41 @@ libwacom_parse_tablet_keyfile(WacomDeviceDatabase *db,
 			      const char *filename)
 {
 	WacomDevice *device = NULL;
-	GKeyFile *keyfile;
+	struct keyfile keyfile;
+	const struct keyfile_section *section;
 	GError *error = NULL;
 	gboolean rc;
 	char *path;
 	char *layout;
-	char *class;
 	char *paired;
-	char **string_list;
+	char *cursor, *item;
 	bool success = FALSE;
-
-	keyfile = g_key_file_new();
+	uint64_t start = libwacom_stats_start(db);
 
 	path = g_build_filename (datadir, filename, NULL);
-	rc = g_key_file_load_from_file(keyfile, path, G_KEY_FILE_NONE, &error);
+	rc = libwacom_keyfile_load(&keyfile, path, &error);
 
 	if (!rc) {
 		DBG("%s: %s\n", path, error->message);
 		goto out;
 	}
 
-	device = g_new0 (WacomDevice, 1);
+	device = libwacom_arena_alloc0(db->arena, sizeof(*device));
 	device->refcnt = 1;
-	device->matches = g_array_new(TRUE, TRUE, sizeof(WacomMatch*));
+	device->arena = libwacom_arena_ref(db->arena);
 
-	string_list = g_key_file_get_string_list(keyfile, DEVICE_GROUP, "DeviceMatch", NULL, NULL);
-	if (!string_list) {
+	section = libwacom_keyfile_get_section(&keyfile, DEVICE_GROUP);
+	cursor = libwacom_keyfile_get_list(section, KF_DEVICE_MATCH);
+	if (!cursor) {
 		DBG("Missing DeviceMatch= line in '%s'\n", path);
 		goto out;
 	} else {
-		guint i;
 		guint nmatches = 0;
-		for (i = 0; string_list[i]; i++) {
-			WacomMatch *m = libwacom_match_from_string(string_list[i]);
+		while ((item = libwacom_keyfile_list_next(&cursor))) {
+			WacomMatch *m = libwacom_match_from_string(db->arena, item);
 			if (!m) {
 				DBG("'%s' is an invalid DeviceMatch in '%s'\n",
-				    string_list[i], path);
+				    item, path);
 				continue;
 			}
 			libwacom_add_match(device, m);
@@ -824,89 +829,79 @@ libwacom_parse_tablet_keyfile(WacomDeviceDatabase *db,
 				libwacom_set_default_match(device, m);
 			libwacom_match_unref(m);
 		}
-		g_strfreev (string_list);
 		if (nmatches == 0)
 			goto out;
 	}
 
-	paired = g_key_file_get_string(keyfile, DEVICE_GROUP, "PairedID", NULL);
-	if (paired) {
-		libwacom_matchstr_to_paired(device, paired);
-		g_free(paired);
-	}
+	paired = libwacom_keyfile_get_string(section, KF_PAIRED_ID);
+	if (paired)
+		libwacom_matchstr_to_paired(device, db->arena, paired);
 
-	device->name = g_key_file_get_string(keyfile, DEVICE_GROUP, "Name", NULL);
-	device->model_name = g_key_file_get_string(keyfile, DEVICE_GROUP, "ModelName", NULL);
+	device->name = libwacom_arena_intern(db->arena,
+					     libwacom_keyfile_get_string(section, KF_NAME));
+	device->model_name = libwacom_arena_intern(db->arena,
+						   libwacom_keyfile_get_string(section, KF_MODEL_NAME));
 	/* ModelName= would give us the empty string, let's make it NULL
 	 * instead */
-	if (device->model_name && strlen(device->model_name) == 0) {
-		free(device->model_name);
+	if (device->model_name && strlen(device->model_name) == 0)
 		device->model_name = NULL;
-	}
-	device->width = g_key_file_get_integer(keyfile, DEVICE_GROUP, "Width", NULL);
-	device->height = g_key_file_get_integer(keyfile, DEVICE_GROUP, "Height", NULL);
+	libwacom_keyfile_get_integer(section, KF_WIDTH, &device->width);
+	libwacom_keyfile_get_integer(section, KF_HEIGHT, &device->height);
 
 	device->integration_flags = WACOM_DEVICE_INTEGRATED_UNSET;
-	string_list = g_key_file_get_string_list(keyfile, DEVICE_GROUP, "IntegratedIn", NULL, NULL);
-	if (string_list) {
-		guint i, n;
+	cursor = libwacom_keyfile_get_list(section, KF_INTEGRATED_IN);
+	if (cursor) {
+		guint n;
 		gboolean found;
 
 		device->integration_flags = WACOM_DEVICE_INTEGRATED_NONE;
-		for (i = 0; string_list[i]; i++) {
+		while ((item = libwacom_keyfile_list_next(&cursor))) {
 			found = FALSE;
 			for (n = 0; n < G_N_ELEMENTS (integration_flags); n++) {
-				if (g_str_equal(string_list[i], integration_flags[n].key)) {
+				if (g_str_equal(item, integration_flags[n].key)) {
 					device->integration_flags |= integration_flags[n].value;
 					found = TRUE;
 					break;
 				}
 			}
 			if (!found)
-				g_warning ("Unrecognized integration flag '%s'", string_list[i]);
+				g_warning ("Unrecognized integration flag '%s'", item);
 		}
-		g_strfreev (string_list);
 	}
 
-	layout = g_key_file_get_string(keyfile, DEVICE_GROUP, "Layout", NULL);
+	layout = libwacom_keyfile_get_string(section, KF_LAYOUT);
 	if (layout) {
 		/* For the layout, we store the full path to the SVG layout */
-		device->layout = g_build_filename (datadir, "layouts", layout, NULL);
-		g_free (layout);
+		device->layout = libwacom_arena_take(db->arena,
+						     g_build_filename (datadir, "layouts", layout, NULL));
 	}
 
-	class = g_key_file_get_string(keyfile, DEVICE_GROUP, "Class", NULL);
-	device->cls = libwacom_class_string_to_enum(class);
-	g_free(class);
+	device->cls = libwacom_class_string_to_enum(libwacom_keyfile_get_string(section, KF_CLASS));
 
-	string_list = g_key_file_get_string_list(keyfile, DEVICE_GROUP, "Styli", NULL, NULL);
-	if (string_list) {
-		libwacom_parse_styli_list(db, device, string_list);
-		g_strfreev (string_list);
+	cursor = libwacom_keyfile_get_list(section, KF_STYLI);
+	if (cursor) {
+		libwacom_parse_styli_list(db, device, cursor);
 	} else {
-		int fallback_eraser = WACOM_ERASER_FALLBACK_ID;
-		int fallback_stylus = WACOM_STYLUS_FALLBACK_ID;
-		device->styli = g_array_new(FALSE, FALSE, sizeof(int));
-		g_array_append_val(device->styli, fallback_eraser);
-		g_array_append_val(device->styli, fallback_stylus);
+		device->styli = libwacom_arena_alloc0(db->arena, 2 * sizeof(int));
+		device->styli[0] = WACOM_ERASER_FALLBACK_ID;
+		device->styli[1] = WACOM_STYLUS_FALLBACK_ID;
+		device->num_styli = 2;
 	}
 
-	device->num_strips = g_key_file_get_integer(keyfile, FEATURES_GROUP, "NumStrips", NULL);
-	device->buttons = g_hash_table_new_full(g_direct_hash, g_direct_equal,
-						NULL, g_free);
-	device->status_leds = g_array_new (FALSE, FALSE, sizeof(WacomStatusLEDs));
-
-	libwacom_parse_features(device, keyfile);
-	libwacom_parse_buttons(device, keyfile);
-	libwacom_parse_keys(device, keyfile);
+	section = libwacom_keyfile_get_section(&keyfile, FEATURES_GROUP);
+	libwacom_parse_features(device, section);
+	libwacom_parse_buttons(device, &keyfile);
+	libwacom_parse_keys(device, &keyfile);
+	libwacom_update_hash(device);
 
 	success = TRUE;
 
 out:
-	if (path)
+	if (path) {
+		libwacom_stats_file_parsed(db, path, start);
 		g_free(path);
-	if (keyfile)
-		g_key_file_free(keyfile);
+	}
+	libwacom_keyfile_release(&keyfile);
 	if (error)
 		g_error_free(error);
 	if (!success)
@@ -942,6 +937,165 @@ is_stylus_file(const struct dirent *entry)
 	return has_suffix(entry->d_name, STYLUS_SUFFIX);
 }
 
+/* Adds a parsed tablet to the database, dropping its reference to the
+ * device. keyset is the set of all matches in the tablet's data
+ * directory so far. */
+static bool
+add_tablet(WacomDeviceDatabase *db, GHashTable *keyset, WacomDevice *d)
+{
+	int idx = 0;
+	bool success = false;
+
+	if (d->num_matches == 0) {
+		g_critical("Device '%s' has no matches defined\n",
+			   libwacom_get_name(d));
+		goto out;
+	}
+
+	/* Note: we may change the array while iterating over it */
+	while (idx < d->num_matches) {
+		WacomMatch *match = d->matches[idx];
+		const char *matchstr;
+
+		matchstr = libwacom_match_get_match_string(match);
+		/* no duplicate matches allowed within the same
+		 * directory */
+		if (g_hash_table_contains(keyset, matchstr)) {
+			g_critical("Duplicate match of '%s' on device '%s'.",
+				   matchstr, libwacom_get_name(d));
+			goto out;
+		}
+		g_hash_table_add(keyset, g_strdup(matchstr));
+
+		/* We already have an entry for this match in the database,
+		 * that takes precedence. Remove the current match
+		 * from the new tablet - that's fine because we
+		 * haven't exposed the tablet yet.
+		 */
+		if (g_hash_table_lookup(db->device_ht, matchstr)) {
+			libwacom_remove_match(d, match);
+			continue;
+		}
+
+		libwacom_database_add_device(db, matchstr, match,
+					     libwacom_ref(d));
+		idx++;
+	}
+
+	success = true;
+
+out:
+	libwacom_unref(d);
+	return success;
+}
+
+/* WDATABASE_WATCH: a tablet file and all of its matches, whether the
+ * file owns the device_ht entry for a match is in match_files */
+struct tablet_file {
+	size_t dir_index;
+	char *filename;
+	char **matches;
+};
+
+static void
+tablet_file_free(void *data)
+{
+	struct tablet_file *file = data;
+
+	g_strfreev(file->matches);
+	g_free(file->filename);
+	g_free(file);
+}
+
+static struct tablet_file *
+tablet_file_new(size_t dir_index, const char *filename, const WacomDevice *d)
+{
+	struct tablet_file *file;
+
+	file = g_new0(struct tablet_file, 1);
+	file->dir_index = dir_index;
+	file->filename = g_strdup(filename);
+	file->matches = g_new0(char *, d->num_matches + 1);
+	for (int i = 0; i < d->num_matches; i++) {
+		const WacomMatch *match = d->matches[i];
+
+		file->matches[i] = g_strdup(libwacom_match_get_match_string(match));
+	}
+
+	return file;
+}
+
+/* Adds a file to tablet_files and to match_claims for each of its matches.
+ * The claims stay sorted by directory, a file is added after the files of
+ * its directory. */
+static void
+add_tablet_file(WacomDeviceDatabase *db, char *path, struct tablet_file *file)
+{
+	g_hash_table_insert(db->tablet_files, path, file);
+
+	for (char **m = file->matches; *m; m++) {
+		GPtrArray *claims = g_hash_table_lookup(db->match_claims, *m);
+		guint idx;
+
+		if (!claims) {
+			claims = g_ptr_array_new();
+			g_hash_table_insert(db->match_claims, g_strdup(*m), claims);
+		}
+
+		for (idx = 0; idx < claims->len; idx++) {
+			const struct tablet_file *other = g_ptr_array_index(claims, idx);
+
+			if (other->dir_index > file->dir_index)
+				break;
+		}
+		g_ptr_array_insert(claims, idx, file);
+	}
+}
+
+/* Removes and frees a file added with add_tablet_file() */
+static void
+remove_tablet_file(WacomDeviceDatabase *db, const char *path, struct tablet_file *file)
+{
+	for (char **m = file->matches; *m; m++) {
+		GPtrArray *claims = g_hash_table_lookup(db->match_claims, *m);
+
+		/* Gone already if the file lists the match twice */
+		if (!claims)
+			continue;
+
+		g_ptr_array_remove(claims, file);
+		if (claims->len == 0)
+			g_hash_table_remove(db->match_claims, *m);
+	}
+
+	g_hash_table_remove(db->tablet_files, path);
+}
+
+/* Records the file a tablet is loaded from, call before add_tablet() */
+static void
+track_tablet_file(WacomDeviceDatabase *db, const char *datadir,
+		  const char *filename, const WacomDevice *d)
+{
+	struct tablet_file *file;
+	size_t dir_index = 0;
+
+	if (!db->datadirs)
+		return;
+
+	while (db->datadirs[dir_index] &&
+	       !g_str_equal(db->datadirs[dir_index], datadir))
+		dir_index++;
+
+	file = tablet_file_new(dir_index, filename, d);
+	add_tablet_file(db, g_build_filename(datadir, filename, NULL), file);
+
+	/* Earlier directories take precedence, see add_tablet() */
+	for (char **m = file->matches; *m; m++) {
+		if (!g_hash_table_contains(db->device_ht, *m))
+			g_hash_table_insert(db->match_files, g_strdup(*m), file);
+	}
+}
+
 static bool
 load_tablet_files(WacomDeviceDatabase *db, const char *datadir)
 {
@@ -964,7 +1118,6 @@ load_tablet_files(WacomDeviceDatabase *db, const char *datadir)
 
 	while ((file = readdir(dir))) {
 		WacomDevice *d;
-		guint idx = 0;
 
 		if (!is_tablet_file(file))
 			continue;
@@ -973,44 +1126,9 @@ load_tablet_files(WacomDeviceDatabase *db, const char *datadir)
 		if (!d)
 			continue;
 
-		if (d->matches->len == 0) {
-			g_critical("Device '%s' has no matches defined\n",
-				   libwacom_get_name(d));
+		track_tablet_file(db, datadir, file->d_name, d);
+		if (!add_tablet(db, keyset, d))
 			goto out;
-		}
-
-		/* Note: we may change the array while iterating over it */
-		while (idx < d->matches->len) {
-			WacomMatch *match = g_array_index(d->matches, WacomMatch*, idx);
-			const char *matchstr;
-
-			matchstr = libwacom_match_get_match_string(match);
-			/* no duplicate matches allowed within the same
-			 * directory */
-			if (g_hash_table_contains(keyset, matchstr)) {
-				g_critical("Duplicate match of '%s' on device '%s'.",
-					   matchstr, libwacom_get_name(d));
-				goto out;
-			}
-			g_hash_table_add(keyset, g_strdup(matchstr));
-
-			/* We already have an entry for this match in the database,
-			 * that takes precedence. Remove the current match
-			 * from the new tablet - that's fine because we
-			 * haven't exposed the tablet yet.
-			 */
-			if (g_hash_table_lookup(db->device_ht, matchstr)) {
-				libwacom_remove_match(d, match);
-				continue;
-			}
-
-			g_hash_table_insert(db->device_ht,
-					    g_strdup (matchstr),
-					    d);
-			libwacom_ref(d);
-			idx++;
-		}
-		libwacom_unref(d);
 	}
 
 	success = true;
@@ -1022,166 +1140,1629 @@ out:
 	return success;
 }
 
+struct pending_tablet {
+	char *datadir;
+	char *filename;
+	bool loaded;
+};
+
 static void
-stylus_destroy(void *data)
+pending_tablet_free(void *data)
 {
-	libwacom_stylus_unref((WacomStylus*)data);
+	struct pending_tablet *tablet = data;
+
+	g_free(tablet->datadir);
+	g_free(tablet->filename);
+	g_free(tablet);
+}
+
+/* Extracts the DeviceMatch entries of a tablet file with the same key file
+ * parser libwacom_parse_tablet_keyfile() uses, without building the
+ * device. The caller must free the returned list with g_strfreev() */
+static char **
+scan_device_matches(const char *datadir, const char *filename)
+{
+	struct keyfile keyfile;
+	const struct keyfile_section *section;
+	GPtrArray *matches = NULL;
+	char *path, *cursor, *item;
+
+	path = g_build_filename(datadir, filename, NULL);
+	if (!libwacom_keyfile_load(&keyfile, path, NULL))
+		goto out;
+
+	section = libwacom_keyfile_get_section(&keyfile, DEVICE_GROUP);
+	cursor = libwacom_keyfile_get_list(section, KF_DEVICE_MATCH);
+	if (!cursor)
+		goto out;
+
+	matches = g_ptr_array_new();
+	while ((item = libwacom_keyfile_list_next(&cursor)))
+		g_ptr_array_add(matches, g_strdup(item));
+	g_ptr_array_add(matches, NULL);
+
+out:
+	libwacom_keyfile_release(&keyfile);
+	g_free(path);
+
+	return matches ? (char **)g_ptr_array_free(matches, FALSE) : NULL;
 }
 
 static bool
-load_stylus_files(WacomDeviceDatabase *db, const char *datadir)
+index_tablet_files(WacomDeviceDatabase *db, const char *datadir)
 {
 	DIR *dir;
 	struct dirent *file;
+	bool success = false;
+	GHashTable *keyset;
 
 	dir = opendir(datadir);
 	if (!dir)
 		return errno == ENOENT; /* non-existing directory is ok */
 
+	/* Same duplicate rules as load_tablet_files() */
+	keyset = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
 	while ((file = readdir(dir))) {
-		char *path;
+		struct pending_tablet *tablet;
+		GPtrArray *candidates;
+		char **matches;
 
-		if (!is_stylus_file(file))
+		if (!is_tablet_file(file))
 			continue;
 
-		path = g_build_filename (datadir, file->d_name, NULL);
-		libwacom_parse_stylus_keyfile(db, path);
-		g_free(path);
-	}
+		matches = scan_device_matches(datadir, file->d_name);
+		if (!matches)
+			continue;
 
-	closedir(dir);
+		tablet = g_new0(struct pending_tablet, 1);
+		tablet->datadir = g_strdup(datadir);
+		tablet->filename = g_strdup(file->d_name);
+		g_ptr_array_add(db->pending_tablets, tablet);
 
-	return true;
-}
+		for (char **m = matches; *m; m++) {
+			WacomMatch *match;
+			const char *matchstr;
 
-static WacomDeviceDatabase *
-database_new_for_paths (size_t npaths, const char **datadirs)
-{
-	WacomDeviceDatabase *db;
-	size_t n;
-	const char **datadir;
+			if (**m == '\0')
+				continue;
 
-	db = g_new0 (WacomDeviceDatabase, 1);
-	db->device_ht = g_hash_table_new_full (g_str_hash,
-					       g_str_equal,
-					       g_free,
-					       (GDestroyNotify) libwacom_destroy);
-	db->stylus_ht = g_hash_table_new_full (g_direct_hash,
-					       g_direct_equal,
-					       NULL,
-					       (GDestroyNotify) stylus_destroy);
+			match = libwacom_match_from_string(db->arena, *m);
+			if (!match)
+				continue;
 
-	for (datadir = datadirs, n = npaths; n--; datadir++) {
-		if (!load_stylus_files(db, *datadir))
-			goto error;
-	}
+			matchstr = libwacom_match_get_match_string(match);
+			if (g_hash_table_contains(keyset, matchstr)) {
+				g_critical("Duplicate match of '%s' in '%s'.",
+					   matchstr, file->d_name);
+				libwacom_match_unref(match);
+				g_strfreev(matches);
+				goto out;
+			}
+			g_hash_table_add(keyset, g_strdup(matchstr));
 
-	for (datadir = datadirs, n = npaths; n--; datadir++) {
-		if (!load_tablet_files(db, *datadir))
-			goto error;
+			/* Earlier directories take precedence, later ones
+			 * provide the match if those fail to parse */
+			candidates = g_hash_table_lookup(db->pending_ht, matchstr);
+			if (!candidates) {
+				candidates = g_ptr_array_new();
+				g_hash_table_insert(db->pending_ht,
+						    g_strdup(matchstr),
+						    candidates);
+			}
+			g_ptr_array_add(candidates, tablet);
+			libwacom_match_unref(match);
+		}
+		g_strfreev(matches);
 	}
 
-	/* If we couldn't load _anything_ then something's wrong */
-	if (g_hash_table_size (db->stylus_ht) == 0 ||
-	    g_hash_table_size (db->device_ht) == 0)
-		goto error;
+	success = true;
 
-	libwacom_setup_paired_attributes(db);
+out:
+	g_hash_table_destroy(keyset);
+	closedir(dir);
+	return success;
+}
 
-	return db;
+/* Drops a loaded tablet from the candidates of all matches */
+static void
+remove_pending_tablet(WacomDeviceDatabase *db, struct pending_tablet *tablet)
+{
+	GHashTableIter iter;
+	gpointer candidates;
 
-error:
-	libwacom_database_destroy(db);
-	return NULL;
+	g_hash_table_iter_init(&iter, db->pending_ht);
+	while (g_hash_table_iter_next(&iter, NULL, &candidates)) {
+		g_ptr_array_remove(candidates, tablet);
+		if (((GPtrArray *)candidates)->len == 0)
+			g_hash_table_iter_remove(&iter);
+	}
+
+	/* Published after all device_ht changes, see all_tablets_loaded() */
+	if (g_hash_table_size(db->pending_ht) == 0)
+		g_atomic_int_set(&db->pending_done, TRUE);
 }
 
-LIBWACOM_EXPORT WacomDeviceDatabase *
-libwacom_database_new_for_path (const char *datadir)
+/* The file that provides the match if it parses, NULL if none is left */
+static struct pending_tablet *
+pending_tablet_for_match(const WacomDeviceDatabase *db, const char *matchstr)
 {
-	return database_new_for_paths(1, &datadir);
+	GPtrArray *candidates = g_hash_table_lookup(db->pending_ht, matchstr);
+
+	return candidates ? g_ptr_array_index(candidates, 0) : NULL;
 }
 
-LIBWACOM_EXPORT WacomDeviceDatabase *
-libwacom_database_new (void)
+static void
+load_pending_tablet(WacomDeviceDatabase *db, struct pending_tablet *tablet)
 {
-	const char *datadir[] = {
-		ETCDIR,
-		DATADIR,
-	};
+	WacomDevice *d;
+	int idx = 0;
+
+	tablet->loaded = true;
+
+	d = libwacom_parse_tablet_keyfile(db, tablet->datadir, tablet->filename);
+	if (d) {
+		/* Note: we may change the array while iterating over it */
+		while (idx < d->num_matches) {
+			WacomMatch *match = d->matches[idx];
+			const char *matchstr = libwacom_match_get_match_string(match);
+			struct pending_tablet *owner;
+
+			/* A file that takes precedence owns the match unless
+			 * it fails to parse, see load_tablet_files() */
+			while ((owner = pending_tablet_for_match(db, matchstr)) &&
+			       owner != tablet && !owner->loaded)
+				load_pending_tablet(db, owner);
+
+			if (g_hash_table_lookup(db->device_ht, matchstr)) {
+				libwacom_remove_match(d, match);
+				continue;
+			}
+
+			libwacom_database_add_device(db, matchstr, match,
+						     libwacom_ref(d));
+			idx++;
+		}
+		libwacom_unref(d);
+	}
 
-	return database_new_for_paths (2, datadir);
+	remove_pending_tablet(db, tablet);
 }
 
-LIBWACOM_EXPORT void
-libwacom_database_destroy(WacomDeviceDatabase *db)
+void
+libwacom_database_lock(const WacomDeviceDatabase *db)
 {
-	if (db->device_ht)
-		g_hash_table_destroy(db->device_ht);
-	if (db->stylus_ht)
-		g_hash_table_destroy(db->stylus_ht);
-	g_free (db);
+	g_mutex_lock((GMutex *)&db->lock);
 }
 
-static gint
-device_compare(gconstpointer pa, gconstpointer pb)
+void
+libwacom_database_unlock(const WacomDeviceDatabase *db)
 {
-	const WacomDevice *a = pa,
-		          *b = pb;
-	int cmp;
-
-	cmp = libwacom_get_vendor_id(a) - libwacom_get_vendor_id(b);
-	if (cmp == 0)
-		cmp = libwacom_get_product_id(a) - libwacom_get_product_id(b);
-	if (cmp == 0)
-		cmp = g_strcmp0(libwacom_get_name(a), libwacom_get_name(b));
-	return cmp;
+	g_mutex_unlock((GMutex *)&db->lock);
 }
 
-static void
-ht_copy_key(gpointer key, gpointer value, gpointer user_data)
+/* Once this returns true the database doesn't change anymore and is read
+ * without the lock */
+static bool
+all_tablets_loaded(const WacomDeviceDatabase *db)
 {
-	g_hash_table_add((GHashTable*)user_data, value);
+	return !db->pending_ht || g_atomic_int_get(&db->pending_done);
 }
 
-LIBWACOM_EXPORT WacomDevice**
-libwacom_list_devices_from_database(const WacomDeviceDatabase *db, WacomError *error)
+/* The lazy loading is invisible to the caller, so this takes a const db
+ * like the public lookup functions. A lazy database is only read under
+ * the lock until all tablets are loaded, the lookups may be in
+ * different threads. */
+WacomDevice *
+libwacom_database_get_device(const WacomDeviceDatabase *db, const char *match)
 {
-	GList *cur, *devices = NULL;
-	WacomDevice **list, **p;
-	GHashTable *ht = NULL;
+	WacomDevice *device;
+	struct pending_tablet *tablet;
+
+	if (all_tablets_loaded(db))
+		return g_hash_table_lookup(db->device_ht, match);
+
+	libwacom_database_lock(db);
+
+	device = g_hash_table_lookup(db->device_ht, match);
+	if (!device) {
+		/* If the file fails to parse, the next one provides
+		 * the match */
+		while (!device && (tablet = pending_tablet_for_match(db, match))) {
+			load_pending_tablet((WacomDeviceDatabase *)db, tablet);
+			device = g_hash_table_lookup(db->device_ht, match);
+		}
+	}
+
+	libwacom_database_unlock(db);
+
+	return device;
+}
+
+/* Nothing changes the database once this returns */
+void
+libwacom_database_load_pending(const WacomDeviceDatabase *db)
+{
+	if (all_tablets_loaded(db))
+		return;
+
+	libwacom_database_lock(db);
+
+	for (guint i = 0; i < db->pending_tablets->len; i++) {
+		struct pending_tablet *tablet = g_ptr_array_index(db->pending_tablets, i);
+
+		if (!tablet->loaded)
+			load_pending_tablet((WacomDeviceDatabase *)db, tablet);
+	}
+
+	libwacom_database_unlock(db);
+}
+
+static void
+stylus_destroy(void *data)
+{
+	libwacom_stylus_unref((WacomStylus*)data);
+}
+
+static bool
+load_stylus_files(WacomDeviceDatabase *db, const char *datadir)
+{
+	DIR *dir;
+	struct dirent *file;
+
+	dir = opendir(datadir);
+	if (!dir)
+		return errno == ENOENT; /* non-existing directory is ok */
+
+	while ((file = readdir(dir))) {
+		uint64_t start;
+		char *path;
+
+		if (!is_stylus_file(file))
+			continue;
+
+		start = libwacom_stats_start(db);
+		path = g_build_filename (datadir, file->d_name, NULL);
+		libwacom_parse_stylus_keyfile(db->arena, db->stylus_ht, path);
+		libwacom_stats_file_parsed(db, path, start);
+		g_free(path);
+	}
+
+	closedir(dir);
+
+	return true;
+}
+
+/* WDATABASE_PARALLEL: the data files are parsed in a thread pool, the
+ * results are then added to the database in the same order as the
+ * sequential loader would add them. */
+struct parse_job {
+	size_t dir_index;
+	const char *datadir;
+	char *filename;
+	GHashTable *styli;	/* stylus files: ID : WacomStylus */
+	WacomDevice *device;	/* tablet files */
+};
+
+static void
+parse_job_free(void *data)
+{
+	struct parse_job *job = data;
+
+	if (job->styli)
+		g_hash_table_destroy(job->styli);
+	libwacom_unref(job->device);
+	g_free(job->filename);
+	g_free(job);
+}
+
+static void
+parse_job_run(gpointer data, gpointer user_data)
+{
+	struct parse_job *job = data;
+	WacomDeviceDatabase *db = user_data;
+	char *path;
+
+	if (job->styli) {
+		uint64_t start = libwacom_stats_start(db);
+
+		path = g_build_filename (job->datadir, job->filename, NULL);
+		libwacom_parse_stylus_keyfile(db->arena, job->styli, path);
+		libwacom_stats_file_parsed(db, path, start);
+		g_free(path);
+	} else {
+		/* Only reads the stylus table, which is complete by now */
+		job->device = libwacom_parse_tablet_keyfile(db, job->datadir,
+							    job->filename);
+	}
+}
+
+static bool
+list_parse_jobs(GPtrArray *jobs, size_t npaths, const char **datadirs,
+		int (*filter)(const struct dirent *), bool styli)
+{
+	for (size_t n = 0; n < npaths; n++) {
+		DIR *dir;
+		struct dirent *file;
+
+		dir = opendir(datadirs[n]);
+		if (!dir) {
+			if (errno == ENOENT) /* non-existing directory is ok */
+				continue;
+			return false;
+		}
+
+		while ((file = readdir(dir))) {
+			struct parse_job *job;
+
+			if (!filter(file))
+				continue;
+
+			job = g_new0(struct parse_job, 1);
+			job->dir_index = n;
+			job->datadir = datadirs[n];
+			job->filename = g_strdup(file->d_name);
+			if (styli)
+				job->styli = g_hash_table_new_full(g_direct_hash,
+								   g_direct_equal,
+								   NULL,
+								   (GDestroyNotify) stylus_destroy);
+			g_ptr_array_add(jobs, job);
+		}
+
+		closedir(dir);
+	}
+
+	return true;
+}
+
+static void
+run_parse_jobs(WacomDeviceDatabase *db, GPtrArray *jobs)
+{
+	GThreadPool *pool;
+
+	pool = g_thread_pool_new(parse_job_run, db,
+				 g_get_num_processors(), FALSE, NULL);
+	for (guint i = 0; i < jobs->len; i++)
+		g_thread_pool_push(pool, g_ptr_array_index(jobs, i), NULL);
+
+	/* Waits for all jobs to finish */
+	g_thread_pool_free(pool, FALSE, TRUE);
+}
+
+static bool
+load_files_parallel(WacomDeviceDatabase *db, size_t npaths, const char **datadirs)
+{
+	GPtrArray *jobs;
+	GHashTable *keyset = NULL;
+	size_t dir_index = 0;
+	bool success = false;
+
+	jobs = g_ptr_array_new_with_free_func(parse_job_free);
+
+	if (!list_parse_jobs(jobs, npaths, datadirs, is_stylus_file, true))
+		goto out;
+	run_parse_jobs(db, jobs);
+
+	for (guint i = 0; i < jobs->len; i++) {
+		struct parse_job *job = g_ptr_array_index(jobs, i);
+		GHashTableIter iter;
+		gpointer value;
+
+		g_hash_table_iter_init(&iter, job->styli);
+		while (g_hash_table_iter_next(&iter, NULL, &value)) {
+			g_hash_table_iter_steal(&iter);
+			add_stylus(db->stylus_ht, value);
+		}
+	}
+	g_ptr_array_set_size(jobs, 0);
+
+	if (!list_parse_jobs(jobs, npaths, datadirs, is_tablet_file, false))
+		goto out;
+	run_parse_jobs(db, jobs);
+
+	for (guint i = 0; i < jobs->len; i++) {
+		struct parse_job *job = g_ptr_array_index(jobs, i);
+		WacomDevice *d = job->device;
+
+		/* See load_tablet_files() for the duplicate rules */
+		if (!keyset || job->dir_index != dir_index) {
+			if (keyset)
+				g_hash_table_destroy(keyset);
+			keyset = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+			dir_index = job->dir_index;
+		}
+
+		if (!d)
+			continue;
+
+		job->device = NULL;
+		track_tablet_file(db, job->datadir, job->filename, d);
+		if (!add_tablet(db, keyset, d))
+			goto out;
+	}
+
+	success = true;
+
+out:
+	if (keyset)
+		g_hash_table_destroy(keyset);
+	g_ptr_array_free(jobs, TRUE);
+	return success;
+}
+
+static inline uint64_t
+hash_mix(uint64_t h)
+{
+	/* splitmix64 finalizer */
+	h ^= h >> 30;
+	h *= 0xbf58476d1ce4e5b9ULL;
+	h ^= h >> 27;
+	h *= 0x94d049bb133111ebULL;
+	h ^= h >> 31;
+	return h;
+}
+
+bool
+libwacom_datadir_signature(const char *datadir, uint64_t *signature)
+{
+	DIR *dir;
+	struct dirent *file;
+	uint64_t sig = 0;
+
+	/* A non-existing directory has the same signature as an empty one */
+	dir = opendir(datadir);
+	if (!dir) {
+		*signature = 0;
+		return errno == ENOENT;
+	}
+
+	while ((file = readdir(dir))) {
+		struct stat st;
+		uint64_t h = 0xcbf29ce484222325ULL; /* FNV-1a */
+
+		if (!is_tablet_file(file) && !is_stylus_file(file))
+			continue;
+
+		if (fstatat(dirfd(dir), file->d_name, &st, 0) == -1)
+			continue;
+
+		for (const char *c = file->d_name; *c; c++) {
+			h ^= (unsigned char)*c;
+			h *= 0x100000001b3ULL;
+		}
+		h = hash_mix(h ^ (uint64_t)st.st_size);
+		h = hash_mix(h ^ (uint64_t)st.st_mtim.tv_sec);
+		h = hash_mix(h ^ (uint64_t)st.st_mtim.tv_nsec);
+
+		/* readdir() order is unspecified, so combine commutatively */
+		sig += h;
+	}
+
+	closedir(dir);
+	*signature = sig;
+
+	return true;
+}
+
+/* The usbid index maps the bus, vendor and product ID of a match to the
+ * devices with that ID, so lookups don't need to format and hash a match
+ * string. Matches with a name are in the bucket's named list. */
+struct usbid_entry {
+	const char *name;	/* borrowed from the device's match */
+	const WacomDevice *device;
+};
+
+struct usbid_bucket {
+	gint64 key;
+	const WacomDevice *device;	/* the match without a name */
+	GArray *named;			/* struct usbid_entry */
+};
+
+static void
+usbid_bucket_free(void *data)
+{
+	struct usbid_bucket *bucket = data;
+
+	if (bucket->named)
+		g_array_free(bucket->named, TRUE);
+	g_free(bucket);
+}
+
+static inline bool
+usbid_key(WacomBusType bus, int vendor_id, int product_id, gint64 *key)
+{
+	/* All real IDs are 16 bit, anything else stays in device_ht only */
+	if (vendor_id < 0 || vendor_id > 0xffff ||
+	    product_id < 0 || product_id > 0xffff)
+		return false;
+
+	*key = ((gint64)bus << 32) | ((gint64)vendor_id << 16) | product_id;
+	return true;
+}
+
+/* Adds a device_ht entry to the secondary indexes */
+static void
+index_device(WacomDeviceDatabase *db, const char *matchstr,
+	     const WacomMatch *match, WacomDevice *device)
+{
+	struct usbid_bucket *bucket;
+	gint64 key;
+
+	/* The first device with a name wins, same as for matches */
+	if (device->name && !g_hash_table_contains(db->name_ht, device->name))
+		g_hash_table_insert(db->name_ht, device->name, device);
+	if (device->model_name &&
+	    !g_hash_table_contains(db->model_name_ht, device->model_name))
+		g_hash_table_insert(db->model_name_ht, device->model_name, device);
+
+	/* The generic device can't be looked up by ID */
+	if (g_str_equal(matchstr, GENERIC_DEVICE_MATCH) ||
+	    !usbid_key(match->bus, match->vendor_id, match->product_id, &key))
+		return;
+
+	bucket = g_hash_table_lookup(db->usbid_ht, &key);
+	if (!bucket) {
+		bucket = g_new0(struct usbid_bucket, 1);
+		bucket->key = key;
+		g_hash_table_insert(db->usbid_ht, &bucket->key, bucket);
+	}
+
+	if (match->name) {
+		struct usbid_entry entry = {
+			.name = match->name,
+			.device = device,
+		};
+
+		if (!bucket->named)
+			bucket->named = g_array_new(FALSE, FALSE, sizeof(entry));
+		g_array_append_val(bucket->named, entry);
+	} else {
+		bucket->device = device;
+	}
+}
+
+/* The unique devices of device_ht, sorted and NULL terminated, and a
+ * bitmap over them for each capability, class and bus for
+ * libwacom_database_query_devices(). Bit n is devices[n]. */
+struct device_index {
+	WacomDevice **devices;
+	int ndevices;
+	int nwords;		/* of each bitmap */
+	guint64 *bitmaps;	/* NUM_BITMAPS bitmaps */
+	GHashTable *vendors;	/* key = vendor ID, value = bitmap */
+};
+
+#define NUM_QUERY_FLAGS 9
+#define BITMAP_CLASS(cls) (NUM_QUERY_FLAGS + (cls))
+#define BITMAP_BUS(bus) (BITMAP_CLASS(WCLASS_REMOTE + 1) + (bus))
+#define NUM_BITMAPS BITMAP_BUS(WBUSTYPE_I2C + 1)
+
+static void
+device_index_free(struct device_index *index)
+{
+	if (!index)
+		return;
+
+	g_free(index->devices);
+	g_free(index->bitmaps);
+	g_hash_table_destroy(index->vendors);
+	g_free(index);
+}
+
+/* Called whenever device_ht changes. Only happens before the index is
+ * built or in libwacom_database_dispatch(), nobody can be using it. */
+static void
+invalidate_device_list(WacomDeviceDatabase *db)
+{
+	device_index_free(db->index);
+	db->index = NULL;
+}
+
+/* Takes the device reference, matchstr must be the interned match
+ * string of one of the device's matches. device_ht borrows the key from
+ * the device, so an existing entry's key is replaced along with its
+ * device, the old key may be freed with it. */
+void
+libwacom_database_add_device(WacomDeviceDatabase *db, const char *matchstr,
+			     const WacomMatch *match, WacomDevice *device)
+{
+	g_hash_table_replace(db->device_ht, (char *)matchstr, device);
+	index_device(db, matchstr, match, device);
+	invalidate_device_list(db);
+}
+
+struct reindex_entry {
+	const char *matchstr;
+	const WacomMatch *match;
+	WacomDevice *device;
+	const struct tablet_file *file;
+	int match_index;
+};
+
+/* Load order: directory, file name, match in the file */
+static gint
+reindex_entry_compare(gconstpointer pa, gconstpointer pb)
+{
+	const struct reindex_entry *a = pa, *b = pb;
+	int cmp;
+
+	if (!a->file || !b->file)
+		return (a->file == NULL) - (b->file == NULL);
+
+	if (a->file->dir_index != b->file->dir_index)
+		return a->file->dir_index < b->file->dir_index ? -1 : 1;
+
+	cmp = strcmp(a->file->filename, b->file->filename);
+	if (cmp == 0)
+		cmp = a->match_index - b->match_index;
+
+	return cmp;
+}
+
+/* Rebuilds the secondary indexes after entries were removed from
+ * device_ht. match_files are the tablet files of the entries, the first
+ * device with a name wins like when loading, so the entries are indexed
+ * in load order rather than in hash table order. */
+static void
+reindex_devices(WacomDeviceDatabase *db, GHashTable *match_files)
+{
+	GHashTableIter iter;
+	gpointer key, value;
+	GArray *entries;
+
+	g_hash_table_remove_all(db->name_ht);
+	g_hash_table_remove_all(db->model_name_ht);
+	g_hash_table_remove_all(db->usbid_ht);
+	invalidate_device_list(db);
+
+	entries = g_array_sized_new(FALSE, FALSE, sizeof(struct reindex_entry),
+				    g_hash_table_size(db->device_ht));
+
+	g_hash_table_iter_init(&iter, db->device_ht);
+	while (g_hash_table_iter_next(&iter, &key, &value)) {
+		WacomDevice *device = value;
+
+		for (int i = 0; i < device->num_matches; i++) {
+			const WacomMatch *match = device->matches[i];
+
+			if (g_str_equal(libwacom_match_get_match_string(match), key)) {
+				struct reindex_entry entry = {
+					.matchstr = key,
+					.match = match,
+					.device = device,
+					.file = g_hash_table_lookup(match_files, key),
+					.match_index = i,
+				};
+
+				g_array_append_val(entries, entry);
+				break;
+			}
+		}
+	}
+
+	g_array_sort(entries, reindex_entry_compare);
+	for (guint i = 0; i < entries->len; i++) {
+		struct reindex_entry *entry = &g_array_index(entries, struct reindex_entry, i);
+
+		index_device(db, entry->matchstr, entry->match, entry->device);
+	}
+
+	g_array_free(entries, TRUE);
+}
+
+static GHashTable *
+stylus_table_new(void)
+{
+	return g_hash_table_new_full (g_direct_hash,
+				      g_direct_equal,
+				      NULL,
+				      (GDestroyNotify) stylus_destroy);
+}
+
+/* Removes the device_ht entries owned by file */
+static void
+untrack_tablet_file(WacomDeviceDatabase *db, struct tablet_file *file)
+{
+	for (char **m = file->matches; *m; m++) {
+		if (g_hash_table_lookup(db->match_files, *m) != file)
+			continue;
+
+		g_hash_table_remove(db->match_files, *m);
+		g_hash_table_remove(db->device_ht, *m);
+	}
+}
+
+/* The file that should own a match: the earliest directory wins, within
+ * one directory the current owner keeps it */
+static struct tablet_file *
+find_match_owner(WacomDeviceDatabase *db, const char *matchstr)
+{
+	struct tablet_file *owner, *first;
+	GPtrArray *claims;
+
+	claims = g_hash_table_lookup(db->match_claims, matchstr);
+	if (!claims)
+		return NULL;
+
+	first = g_ptr_array_index(claims, 0);
+	owner = g_hash_table_lookup(db->match_files, matchstr);
+	if (owner && owner->dir_index <= first->dir_index)
+		return owner;
+
+	return first;
+}
+
+/* Replaces all entries of the file with the ones from the freshly
+ * parsed device d, dropping the reference to d */
+static void
+retrack_tablet_file(WacomDeviceDatabase *db, struct tablet_file *file, WacomDevice *d)
+{
+	int idx = 0;
+
+	untrack_tablet_file(db, file);
+
+	/* Note: we may change the array while iterating over it */
+	while (idx < d->num_matches) {
+		WacomMatch *match = d->matches[idx];
+		const char *matchstr = libwacom_match_get_match_string(match);
+		struct tablet_file *owner = find_match_owner(db, matchstr);
+
+		if (owner != file) {
+			/* Reported like when loading, but the reload goes on */
+			if (owner && owner->dir_index == file->dir_index)
+				g_critical("Duplicate match of '%s' on device '%s'.",
+					   matchstr, libwacom_get_name(d));
+			libwacom_remove_match(d, match);
+			continue;
+		}
+
+		g_hash_table_insert(db->match_files, g_strdup(matchstr), file);
+		libwacom_database_add_device(db, matchstr, match,
+					     libwacom_ref(d));
+		idx++;
+	}
+
+	libwacom_unref(d);
+}
+
+/* Re-parses the tablet files at the given paths and every other file
+ * that gains or loses a match because of them. Returns the number of
+ * files parsed. */
+static int
+reload_tablet_files(WacomDeviceDatabase *db, GHashTable *changed)
+{
+	GHashTable *contested, *affected;
+	GHashTableIter iter;
+	gpointer key, value;
+	int nparsed = 0;
+
+	contested = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	/* key = struct tablet_file *, value = parsed WacomDevice * or NULL */
+	affected = g_hash_table_new(g_direct_hash, g_direct_equal);
+
+	g_hash_table_iter_init(&iter, changed);
+	while (g_hash_table_iter_next(&iter, &key, &value)) {
+		const char *path = key;
+		size_t dir_index = GPOINTER_TO_SIZE(value);
+		struct tablet_file *file;
+		char *filename;
+		WacomDevice *d;
+
+		file = g_hash_table_lookup(db->tablet_files, path);
+		if (file) {
+			for (char **m = file->matches; *m; m++)
+				g_hash_table_add(contested, g_strdup(*m));
+			untrack_tablet_file(db, file);
+			remove_tablet_file(db, path, file);
+		}
+
+		if (!g_file_test(path, G_FILE_TEST_IS_REGULAR))
+			continue;
+
+		filename = g_path_get_basename(path);
+		d = libwacom_parse_tablet_keyfile(db, db->datadirs[dir_index], filename);
+		nparsed++;
+		if (d && d->num_matches > 0) {
+			file = tablet_file_new(dir_index, filename, d);
+			add_tablet_file(db, g_strdup(path), file);
+			g_hash_table_insert(affected, file, d);
+			for (char **m = file->matches; *m; m++)
+				g_hash_table_add(contested, g_strdup(*m));
+		} else {
+			libwacom_unref(d);
+		}
+		g_free(filename);
+	}
+
+	/* Files that win or lose a match need to be parsed again too */
+	g_hash_table_iter_init(&iter, contested);
+	while (g_hash_table_iter_next(&iter, &key, NULL)) {
+		struct tablet_file *owner = find_match_owner(db, key);
+		struct tablet_file *current = g_hash_table_lookup(db->match_files, key);
+
+		if (owner == current)
+			continue;
+
+		if (current && !g_hash_table_contains(affected, current))
+			g_hash_table_insert(affected, current, NULL);
+		if (owner && !g_hash_table_contains(affected, owner))
+			g_hash_table_insert(affected, owner, NULL);
+	}
+
+	g_hash_table_iter_init(&iter, affected);
+	while (g_hash_table_iter_next(&iter, &key, &value)) {
+		struct tablet_file *file = key;
+		WacomDevice *d = value;
+
+		if (!d) {
+			d = libwacom_parse_tablet_keyfile(db, db->datadirs[file->dir_index],
+							  file->filename);
+			nparsed++;
+		}
+
+		if (d)
+			retrack_tablet_file(db, file, d);
+		else
+			untrack_tablet_file(db, file);
+	}
+
+	g_hash_table_destroy(affected);
+	g_hash_table_destroy(contested);
+
+	reindex_devices(db, db->match_files);
+
+	return nparsed;
+}
+
+/* Styli are referenced by the tablet files, so this re-parses all files.
+ * Snapshots hold references to the old styli they use. */
+static void
+reload_stylus_files(WacomDeviceDatabase *db)
+{
+	g_hash_table_remove_all(db->stylus_ht);
+	for (char **datadir = db->datadirs; *datadir; datadir++)
+		load_stylus_files(db, *datadir);
+	libwacom_setup_paired_attributes(db);
+}
+
+/* Adds all tablet files we know of and all tablet files in the data
+ * directories to changed */
+static void
+add_all_tablet_files(WacomDeviceDatabase *db, GHashTable *changed)
+{
+	GHashTableIter iter;
+	gpointer key, value;
+
+	g_hash_table_iter_init(&iter, db->tablet_files);
+	while (g_hash_table_iter_next(&iter, &key, &value)) {
+		struct tablet_file *file = value;
+
+		g_hash_table_insert(changed, g_strdup(key),
+				    GSIZE_TO_POINTER(file->dir_index));
+	}
+
+	for (size_t n = 0; db->datadirs[n]; n++) {
+		DIR *dir;
+		struct dirent *file;
+
+		dir = opendir(db->datadirs[n]);
+		if (!dir)
+			continue;
+
+		while ((file = readdir(dir))) {
+			char *path;
+
+			if (!is_tablet_file(file))
+				continue;
+
+			path = g_build_filename(db->datadirs[n], file->d_name, NULL);
+			if (!g_hash_table_contains(changed, path))
+				g_hash_table_insert(changed, path, GSIZE_TO_POINTER(n));
+			else
+				g_free(path);
+		}
+		closedir(dir);
+	}
+}
+
+/* Copies the current devices and styli into a new database that is
+ * never modified, see libwacom_database_get_snapshot(). Devices and
+ * styli are shared with db, only the tables are new. */
+static WacomDeviceDatabase *
+snapshot_new(const WacomDeviceDatabase *db, const WacomDeviceDatabase *previous)
+{
+	WacomDeviceDatabase *snapshot;
+	GHashTableIter iter;
+	gpointer key, value;
+
+	snapshot = libwacom_database_alloc(NULL);
+	snapshot->stats.enabled = db->stats.enabled;
+
+	g_hash_table_iter_init(&iter, db->device_ht);
+	while (g_hash_table_iter_next(&iter, &key, &value))
+		g_hash_table_replace(snapshot->device_ht, key, libwacom_ref(value));
+	reindex_devices(snapshot, db->match_files);
+
+	g_hash_table_iter_init(&iter, db->stylus_ht);
+	while (g_hash_table_iter_next(&iter, &key, &value))
+		g_hash_table_insert(snapshot->stylus_ht, key,
+				    libwacom_stylus_ref(value));
+
+	/* Device nodes don't change with the data files, so the udev
+	 * cache carries over to the next generation */
+	if (previous) {
+		libwacom_database_lock(previous);
+		if (previous->udev_cache)
+			snapshot->udev_cache = libwacom_udev_cache_ref(previous->udev_cache);
+		libwacom_database_unlock(previous);
+	}
+
+	return snapshot;
+}
+
+/* Readers that got the old snapshot keep it until they destroy it */
+static void
+publish_snapshot(WacomDeviceDatabase *db)
+{
+	WacomDeviceDatabase *old = db->snapshot;
+	WacomDeviceDatabase *snapshot = snapshot_new(db, old);
+
+	libwacom_database_lock(db);
+	db->snapshot = snapshot;
+	libwacom_database_unlock(db);
+
+	libwacom_database_destroy(old);
+}
+
+LIBWACOM_EXPORT WacomDeviceDatabase *
+libwacom_database_get_snapshot(const WacomDeviceDatabase *db)
+{
+	WacomDeviceDatabase *snapshot;
+
+	/* Without WDATABASE_WATCH the database never changes */
+	if (!db->datadirs) {
+		snapshot = (WacomDeviceDatabase *)db;
+		g_atomic_int_inc(&snapshot->refcnt);
+		return snapshot;
+	}
+
+	libwacom_database_lock(db);
+	snapshot = db->snapshot;
+	g_atomic_int_inc(&snapshot->refcnt);
+	libwacom_database_unlock(db);
+
+	return snapshot;
+}
+
+#define WATCH_EVENTS (IN_CLOSE_WRITE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE)
+
+static void
+watch_init(WacomDeviceDatabase *db, size_t npaths, const char **datadirs)
+{
+	db->datadirs = g_new0(char *, npaths + 1);
+	for (size_t n = 0; n < npaths; n++)
+		db->datadirs[n] = g_strdup(datadirs[n]);
+
+	db->tablet_files = g_hash_table_new_full(g_str_hash, g_str_equal,
+						 g_free, tablet_file_free);
+	db->match_files = g_hash_table_new_full(g_str_hash, g_str_equal,
+						g_free, NULL);
+	db->match_claims = g_hash_table_new_full(g_str_hash, g_str_equal,
+						 g_free, (GDestroyNotify)g_ptr_array_unref);
+
+#if HAVE_SYS_INOTIFY_H
+	/* Watch before loading so we don't miss changes made meanwhile */
+	db->watch_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (db->watch_fd < 0) {
+		g_warning("Failed to watch the data directories: %s", strerror(errno));
+		return;
+	}
+
+	db->watches = g_new(int, npaths);
+	for (size_t n = 0; n < npaths; n++)
+		db->watches[n] = inotify_add_watch(db->watch_fd, datadirs[n], WATCH_EVENTS);
+#endif
+}
+
+LIBWACOM_EXPORT int
+libwacom_database_get_fd(const WacomDeviceDatabase *db)
+{
+	return db->watch_fd;
+}
+
+LIBWACOM_EXPORT int
+libwacom_database_dispatch(WacomDeviceDatabase *db)
+{
+#if HAVE_SYS_INOTIFY_H
+	char buf[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+	GHashTable *changed;
+	bool reload_all = false;
+	int nparsed = -1;
+	ssize_t len;
+
+	if (db->watch_fd < 0)
+		return 0;
+
+	/* key = path, value = directory index */
+	changed = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+
+	while ((len = read(db->watch_fd, buf, sizeof(buf))) > 0) {
+		const struct inotify_event *event;
+
+		for (char *ptr = buf; ptr < buf + len;
+		     ptr += sizeof(struct inotify_event) + event->len) {
+			size_t n = 0;
+
+			event = (const struct inotify_event *)ptr;
+
+			if (event->mask & IN_Q_OVERFLOW) {
+				reload_all = true;
+				continue;
+			}
+
+			if (event->len == 0 || event->name[0] == '.')
+				continue;
+
+			while (db->datadirs[n] && db->watches[n] != event->wd)
+				n++;
+			if (!db->datadirs[n])
+				continue;
+
+			if (has_suffix(event->name, STYLUS_SUFFIX))
+				reload_all = true;
+			else if (has_suffix(event->name, TABLET_SUFFIX))
+				g_hash_table_insert(changed,
+						    g_build_filename(db->datadirs[n],
+								     event->name,
+								     NULL),
+						    GSIZE_TO_POINTER(n));
+		}
+	}
+
+	if (len < 0 && errno != EAGAIN)
+		goto out;
+
+	/* Everything parsed from here on holds a reference to a new arena.
+	 * The previous one is freed with the last device or stylus that
+	 * was allocated from it, i.e. once all of them are replaced. */
+	if (reload_all || g_hash_table_size(changed) > 0) {
+		libwacom_arena_unref(db->arena);
+		db->arena = libwacom_arena_new();
+	}
+
+	if (reload_all) {
+		reload_stylus_files(db);
+		add_all_tablet_files(db, changed);
+	}
+
+	nparsed = g_hash_table_size(changed) > 0 ? reload_tablet_files(db, changed) : 0;
+	if (reload_all || nparsed > 0)
+		publish_snapshot(db);
+
+out:
+	g_hash_table_destroy(changed);
+	return nparsed;
+#else
+	return 0;
+#endif
+}
+
+const WacomDevice *
+libwacom_database_lookup(const WacomDeviceDatabase *db, const char *name,
+			 WacomBusType bus, int vendor_id, int product_id)
+{
+	const struct usbid_bucket *bucket;
+	const WacomDevice *device;
+	char *matchstr;
+	gint64 key;
+
+	/* The index is complete unless there are lazy tablets left */
+	if (usbid_key(bus, vendor_id, product_id, &key) &&
+	    all_tablets_loaded(db)) {
+		bucket = g_hash_table_lookup(db->usbid_ht, &key);
+		if (!bucket)
+			return NULL;
+
+		if (!name)
+			return bucket->device;
+
+		for (guint i = 0; bucket->named && i < bucket->named->len; i++) {
+			const struct usbid_entry *entry;
+
+			entry = &g_array_index(bucket->named, struct usbid_entry, i);
+			if (g_str_equal(entry->name, name))
+				return entry->device;
+		}
 
-	if (!db) {
-		libwacom_error_set(error, WERROR_INVALID_DB, "db is NULL");
 		return NULL;
 	}
 
-	/* Devices may be present more than one in the device_ht, so let's
-	 * use a temporary hashtable like a set to filter duplicates */
-	ht = g_hash_table_new (g_direct_hash, g_direct_equal);
-	if (!ht)
+	matchstr = make_match_string(name, bus, vendor_id, product_id);
+	device = libwacom_database_get_device(db, matchstr);
+	g_free(matchstr);
+
+	return device;
+}
+
+WacomDeviceDatabase *
+libwacom_database_alloc(GMappedFile *image)
+{
+	WacomDeviceDatabase *db;
+
+	db = g_new0 (WacomDeviceDatabase, 1);
+	db->refcnt = 1;
+	if (image)
+		db->image = g_mapped_file_ref(image);
+	db->arena = libwacom_arena_new();
+	db->device_ht = g_hash_table_new_full (g_str_hash,
+					       g_str_equal,
+					       NULL,
+					       (GDestroyNotify) libwacom_destroy);
+	db->stylus_ht = stylus_table_new();
+	db->usbid_ht = g_hash_table_new_full (g_int64_hash,
+					      g_int64_equal,
+					      NULL,
+					      usbid_bucket_free);
+	db->name_ht = g_hash_table_new (g_str_hash, g_str_equal);
+	db->model_name_ht = g_hash_table_new (g_str_hash, g_str_equal);
+	db->watch_fd = -1;
+	g_mutex_init(&db->lock);
+	libwacom_stats_init(db);
+
+	return db;
+}
+
+/* Removes all devices and styli */
+void
+libwacom_database_clear(WacomDeviceDatabase *db)
+{
+	g_hash_table_remove_all(db->name_ht);
+	g_hash_table_remove_all(db->model_name_ht);
+	g_hash_table_remove_all(db->usbid_ht);
+	g_hash_table_remove_all(db->device_ht);
+	g_hash_table_remove_all(db->stylus_ht);
+	invalidate_device_list(db);
+}
+
+/* Use the first up-to-date cache in any of the data directories. A cache
+ * is only valid for the exact set of directories it was generated for. */
+static bool
+load_cache(WacomDeviceDatabase *db, size_t npaths, const char **datadirs)
+{
+	for (size_t n = 0; n < npaths; n++) {
+		char *path = g_build_filename(datadirs[n], CACHE_FILENAME, NULL);
+		bool loaded = libwacom_cache_load(db, path, npaths, datadirs);
+
+		g_free(path);
+		if (loaded)
+			return true;
+	}
+
+	return false;
+}
+
+/* A valid cache is used in lazy mode too, it is already fully parsed */
+WacomDeviceDatabase *
+libwacom_database_new_for_paths (size_t npaths, const char **datadirs,
+				 WacomDatabaseFlags flags, bool use_cache)
+{
+	WacomDeviceDatabase *db;
+	size_t n;
+	const char **datadir;
+	bool watch = flags & WDATABASE_WATCH;
+	bool lazy = (flags & WDATABASE_LAZY) && !watch;
+	uint64_t start;
+
+	db = libwacom_database_alloc(NULL);
+	db->stats.enabled = flags & WDATABASE_STATS;
+	start = libwacom_stats_start(db);
+
+	/* A reload needs to know which file each device came from, the
+	 * cache doesn't have that */
+	if (watch)
+		watch_init(db, npaths, datadirs);
+	else if (use_cache && load_cache(db, npaths, datadirs)) {
+		libwacom_stats_add(db, WSTAT_LOAD_TIME, start);
+		return db;
+	}
+
+	if (lazy) {
+		db->pending_ht = g_hash_table_new_full (g_str_hash,
+							g_str_equal,
+							g_free,
+							(GDestroyNotify)g_ptr_array_unref);
+		db->pending_tablets = g_ptr_array_new_with_free_func (pending_tablet_free);
+	}
+
+	if ((flags & WDATABASE_PARALLEL) && !lazy) {
+		if (!load_files_parallel(db, npaths, datadirs))
+			goto error;
+	} else {
+		for (datadir = datadirs, n = npaths; n--; datadir++) {
+			if (!load_stylus_files(db, *datadir))
+				goto error;
+		}
+
+		for (datadir = datadirs, n = npaths; n--; datadir++) {
+			if (lazy ? !index_tablet_files(db, *datadir) :
+				   !load_tablet_files(db, *datadir))
+				goto error;
+		}
+	}
+
+	/* If we couldn't load _anything_ then something's wrong */
+	if (g_hash_table_size (db->stylus_ht) == 0 ||
+	    g_hash_table_size (lazy ? db->pending_ht : db->device_ht) == 0)
+		goto error;
+
+	libwacom_setup_paired_attributes(db);
+	if (watch) {
+		/* Same index order as after a reload, independent of the
+		 * order readdir() returned the files in */
+		reindex_devices(db, db->match_files);
+		db->snapshot = snapshot_new(db, NULL);
+	}
+	libwacom_stats_add(db, WSTAT_LOAD_TIME, start);
+
+	return db;
+
+error:
+	libwacom_database_destroy(db);
+	return NULL;
+}
+
+LIBWACOM_EXPORT WacomDeviceDatabase *
+libwacom_database_new_for_path_with_flags (const char *datadir,
+					   WacomDatabaseFlags flags)
+{
+	return libwacom_database_new_for_paths(1, &datadir, flags, true);
+}
+
+LIBWACOM_EXPORT WacomDeviceDatabase *
+libwacom_database_new_for_path (const char *datadir)
+{
+	return libwacom_database_new_for_path_with_flags(datadir, WDATABASE_DEFAULT);
+}
+
+/* The embedded database replaces DATADIR, local overrides in etcdir are
+ * still read from disk and take precedence the usual way */
+WacomDeviceDatabase *
+libwacom_database_new_embedded(const char *etcdir, WacomDatabaseFlags flags)
+{
+	WacomDeviceDatabase *db;
+	uint64_t start;
+
+	db = libwacom_database_alloc(NULL);
+	db->stats.enabled = flags & WDATABASE_STATS;
+	start = libwacom_stats_start(db);
+
+	if (!load_stylus_files(db, etcdir) ||
+	    !libwacom_cache_load_embedded_styli(db) ||
+	    !load_tablet_files(db, etcdir) ||
+	    !libwacom_cache_load_embedded_devices(db))
 		goto error;
-	g_hash_table_foreach (db->device_ht, ht_copy_key, ht);
 
-	devices = g_hash_table_get_keys (ht);
-	list = calloc (g_list_length (devices) + 1, sizeof (WacomDevice *));
-	if (!list)
+	if (g_hash_table_size (db->stylus_ht) == 0 ||
+	    g_hash_table_size (db->device_ht) == 0)
 		goto error;
 
-	devices = g_list_sort (devices, device_compare);
-	for (p = list, cur = devices; cur; cur = g_list_next (cur))
-		*p++ = (WacomDevice *) cur->data;
-	g_list_free (devices);
-	g_hash_table_destroy (ht);
+	libwacom_setup_paired_attributes(db);
+	libwacom_stats_add(db, WSTAT_LOAD_TIME, start);
 
-	return list;
+	return db;
 
 error:
-	libwacom_error_set(error, WERROR_BAD_ALLOC, "Memory allocation failed");
-	if (ht)
-		g_hash_table_destroy (ht);
-	if (devices)
-		g_list_free (devices);
+	libwacom_database_destroy(db);
 	return NULL;
 }
 
+LIBWACOM_EXPORT WacomDeviceDatabase *
+libwacom_database_new_with_flags (WacomDatabaseFlags flags)
+{
+	const char *datadir[] = {
+		ETCDIR,
+		DATADIR,
+	};
+	size_t len;
+
+	/* Watching needs the files, lazy and parallel loading don't
+	 * apply to a database that is already parsed */
+	if (!(flags & WDATABASE_WATCH) && libwacom_embedded_image(&len))
+		return libwacom_database_new_embedded(ETCDIR, flags);
+
+	return libwacom_database_new_for_paths (2, datadir, flags, true);
+}
+
+LIBWACOM_EXPORT WacomDeviceDatabase *
+libwacom_database_new (void)
+{
+	return libwacom_database_new_with_flags (WDATABASE_DEFAULT);
+}
+
+LIBWACOM_EXPORT void
+libwacom_database_destroy(WacomDeviceDatabase *db)
+{
+	if (!g_atomic_int_dec_and_test(&db->refcnt))
+		return;
+
+	if (db->name_ht)
+		g_hash_table_destroy(db->name_ht);
+	if (db->model_name_ht)
+		g_hash_table_destroy(db->model_name_ht);
+	device_index_free(db->index);
+	if (db->usbid_ht)
+		g_hash_table_destroy(db->usbid_ht);
+	if (db->device_ht)
+		g_hash_table_destroy(db->device_ht);
+	if (db->stylus_ht)
+		g_hash_table_destroy(db->stylus_ht);
+	if (db->pending_ht)
+		g_hash_table_destroy(db->pending_ht);
+	if (db->pending_tablets)
+		g_ptr_array_free(db->pending_tablets, TRUE);
+	if (db->image)
+		g_mapped_file_unref(db->image);
+	libwacom_arena_unref(db->arena);
+	libwacom_udev_cache_unref(db->udev_cache);
+	libwacom_stats_clear(db);
+	g_mutex_clear(&db->lock);
+	if (db->watch_fd >= 0)
+		close(db->watch_fd);
+	g_free(db->watches);
+	if (db->match_files)
+		g_hash_table_destroy(db->match_files);
+	if (db->match_claims)
+		g_hash_table_destroy(db->match_claims);
+	if (db->tablet_files)
+		g_hash_table_destroy(db->tablet_files);
+	g_strfreev(db->datadirs);
+	if (db->snapshot)
+		libwacom_database_destroy(db->snapshot);
+	g_free (db);
+}
+
+static gint
+device_compare(gconstpointer pa, gconstpointer pb)
+{
+	const WacomDevice *a = *(const WacomDevice **)pa,
+		          *b = *(const WacomDevice **)pb;
+	int cmp;
+
+	cmp = libwacom_get_vendor_id(a) - libwacom_get_vendor_id(b);
+	if (cmp == 0)
+		cmp = libwacom_get_product_id(a) - libwacom_get_product_id(b);
+	if (cmp == 0)
+		cmp = g_strcmp0(libwacom_get_name(a), libwacom_get_name(b));
+	/* Keeps the entries of a device adjacent for deduplication */
+	if (cmp == 0)
+		cmp = (a > b) - (a < b);
+	return cmp;
+}
+
+static WacomQueryFlags
+device_query_flags(const WacomDevice *device)
+{
+	WacomIntegrationFlags integration = libwacom_get_integration_flags(device);
+	WacomQueryFlags flags = 0;
+
+	if (libwacom_has_stylus(device))
+		flags |= WQUERY_STYLUS;
+	if (libwacom_has_touch(device))
+		flags |= WQUERY_TOUCH;
+	if (libwacom_has_ring(device))
+		flags |= WQUERY_RING;
+	if (libwacom_has_ring2(device))
+		flags |= WQUERY_RING2;
+	if (libwacom_get_num_strips(device) > 0)
+		flags |= WQUERY_TOUCHSTRIP;
+	if (libwacom_has_touchswitch(device))
+		flags |= WQUERY_TOUCHSWITCH;
+	if (libwacom_is_reversible(device))
+		flags |= WQUERY_REVERSIBLE;
+	if (integration & WACOM_DEVICE_INTEGRATED_DISPLAY)
+		flags |= WQUERY_INTEGRATED_DISPLAY;
+	if (integration & WACOM_DEVICE_INTEGRATED_SYSTEM)
+		flags |= WQUERY_INTEGRATED_SYSTEM;
+
+	return flags;
+}
+
+static inline void
+bitmap_set(guint64 *bitmap, int bit)
+{
+	bitmap[bit / 64] |= (guint64)1 << (bit % 64);
+}
+
+static void
+index_device_bits(struct device_index *index, int n)
+{
+	const WacomDevice *device = index->devices[n];
+	WacomQueryFlags flags = device_query_flags(device);
+	WacomClass cls = libwacom_get_class(device);
+
+	for (int i = 0; i < NUM_QUERY_FLAGS; i++) {
+		if (flags & (1 << i))
+			bitmap_set(&index->bitmaps[i * index->nwords], n);
+	}
+
+	if ((unsigned int)cls <= WCLASS_REMOTE)
+		bitmap_set(&index->bitmaps[BITMAP_CLASS(cls) * index->nwords], n);
+
+	/* A device has each bus and vendor of any of its matches */
+	for (int i = 0; i < device->num_matches; i++) {
+		const WacomMatch *match = device->matches[i];
+		guint64 *bitmap;
+
+		if ((unsigned int)match->bus <= WBUSTYPE_I2C)
+			bitmap_set(&index->bitmaps[BITMAP_BUS(match->bus) * index->nwords], n);
+
+		bitmap = g_hash_table_lookup(index->vendors,
+					     GINT_TO_POINTER(match->vendor_id));
+		if (!bitmap) {
+			bitmap = g_new0(guint64, index->nwords);
+			g_hash_table_insert(index->vendors,
+					    GINT_TO_POINTER(match->vendor_id), bitmap);
+		}
+		bitmap_set(bitmap, n);
+	}
+}
+
+/* Called with the database lock held */
+static void
+build_device_index(WacomDeviceDatabase *db)
+{
+	struct device_index *index;
+	GHashTableIter iter;
+	gpointer value;
+	WacomDevice **devices;
+	int n = 0;
+
+	/* Devices are in device_ht once for each match */
+	devices = g_new(WacomDevice *, g_hash_table_size(db->device_ht) + 1);
+	g_hash_table_iter_init(&iter, db->device_ht);
+	while (g_hash_table_iter_next(&iter, NULL, &value))
+		devices[n++] = value;
+
+	qsort(devices, n, sizeof(*devices), device_compare);
+
+	index = g_new0(struct device_index, 1);
+	index->devices = devices;
+	for (int i = 0; i < n; i++) {
+		if (index->ndevices == 0 || devices[index->ndevices - 1] != devices[i])
+			devices[index->ndevices++] = devices[i];
+	}
+	devices[index->ndevices] = NULL;
+
+	index->nwords = (index->ndevices + 63) / 64;
+	index->bitmaps = g_new0(guint64, (size_t)NUM_BITMAPS * index->nwords);
+	index->vendors = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+					       NULL, g_free);
+	for (int i = 0; i < index->ndevices; i++)
+		index_device_bits(index, i);
+
+	g_atomic_pointer_set(&db->index, index);
+}
+
+/* Built once, a fully loaded database doesn't change anymore */
+static const struct device_index *
+get_device_index(const WacomDeviceDatabase *db)
+{
+	struct device_index *index;
+
+	index = g_atomic_pointer_get(&db->index);
+	if (index)
+		return index;
+
+	libwacom_database_load_pending(db);
+
+	libwacom_database_lock(db);
+	if (!db->index)
+		build_device_index((WacomDeviceDatabase *)db);
+	index = db->index;
+	libwacom_database_unlock(db);
+
+	return index;
+}
+
+LIBWACOM_EXPORT const WacomDevice * const *
+libwacom_database_get_devices(const WacomDeviceDatabase *db, int *ndevices)
+{
+	const struct device_index *index;
+
+	g_return_val_if_fail(db, NULL);
+
+	index = get_device_index(db);
+	if (ndevices)
+		*ndevices = index->ndevices;
+
+	return (const WacomDevice * const *)index->devices;
+}
+
+LIBWACOM_EXPORT int
+libwacom_database_query_devices(const WacomDeviceDatabase *db,
+				WacomQueryFlags flags,
+				WacomClass cls,
+				WacomBusType bus,
+				int vendor_id,
+				const WacomDevice **devices,
+				int ndevices)
+{
+	const struct device_index *index;
+	const guint64 *bitmaps[NUM_QUERY_FLAGS + 3];
+	int nbitmaps = 0;
+	int count = 0;
+
+	g_return_val_if_fail(db, 0);
+	g_return_val_if_fail(ndevices == 0 || devices, 0);
+
+	if (flags & ~((1 << NUM_QUERY_FLAGS) - 1) ||
+	    (unsigned int)cls > WCLASS_REMOTE ||
+	    (unsigned int)bus > WBUSTYPE_I2C)
+		return 0;
+
+	index = get_device_index(db);
+
+	for (int i = 0; i < NUM_QUERY_FLAGS; i++) {
+		if (flags & (1 << i))
+			bitmaps[nbitmaps++] = &index->bitmaps[i * index->nwords];
+	}
+	if (cls != WCLASS_UNKNOWN)
+		bitmaps[nbitmaps++] = &index->bitmaps[BITMAP_CLASS(cls) * index->nwords];
+	if (bus != WBUSTYPE_UNKNOWN)
+		bitmaps[nbitmaps++] = &index->bitmaps[BITMAP_BUS(bus) * index->nwords];
+	if (vendor_id != -1) {
+		const guint64 *bitmap = g_hash_table_lookup(index->vendors,
+							    GINT_TO_POINTER(vendor_id));
+		if (!bitmap)
+			return 0;
+		bitmaps[nbitmaps++] = bitmap;
+	}
+
+	for (int w = 0; w < index->nwords; w++) {
+		guint64 bits = ~(guint64)0;
+
+		/* The bits past the last device */
+		if (w == index->nwords - 1 && index->ndevices % 64)
+			bits >>= 64 - index->ndevices % 64;
+
+		for (int i = 0; i < nbitmaps && bits; i++)
+			bits &= bitmaps[i][w];
+
+		while (bits) {
+			int bit = __builtin_ctzll(bits);
+
+			if (count < ndevices)
+				devices[count] = index->devices[w * 64 + bit];
+			count++;
+			bits &= bits - 1;
+		}
+	}
+
+	return count;
+}
+
+LIBWACOM_EXPORT WacomDevice**
+libwacom_list_devices_from_database(const WacomDeviceDatabase *db, WacomError *error)
+{
+	const WacomDevice * const *devices;
+	WacomDevice **list;
+	int ndevices;
+
+	if (!db) {
+		libwacom_error_set(error, WERROR_INVALID_DB, "db is NULL");
+		return NULL;
+	}
+
+	devices = libwacom_database_get_devices(db, &ndevices);
+	list = calloc (ndevices + 1, sizeof (WacomDevice *));
+	if (!list) {
+		libwacom_error_set(error, WERROR_BAD_ALLOC, "Memory allocation failed");
+		return NULL;
+	}
+	memcpy(list, devices, ndevices * sizeof(*list));
+
+	return list;
+}
+
 /* vim: set noexpandtab tabstop=8 shiftwidth=8: */
@@ -0,0 +1,403 @@
+/*
+ * Copyright © 2026 Red Hat, Inc.
+ *
+ * Permission to use, copy, modify, distribute, and sell this software
+ * and its documentation for any purpose is hereby granted without
+ * fee, provided that the above copyright notice appear in all copies
+ * and that both that copyright notice and this permission notice
+ * appear in supporting documentation, and that the name of Red Hat
+ * not be used in advertising or publicity pertaining to distribution
+ * of the software without specific, written prior permission.  Red
+ * Hat makes no representations about the suitability of this software
+ * for any purpose.  It is provided "as is" without express or implied
+ * warranty.
+ *
+ * THE AUTHORS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS SOFTWARE,
+ * INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS, IN
+ * NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS
+ * OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT,
+ * NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libwacomint.h"
+
+/* The .tablet and .stylus files use a subset of the GKeyFile format:
+ * groups, key=value pairs, comments and escapes in string values. The
+ * file is read once, the values stay in the file's buffer and every
+ * key we know about lands in its slot of the section. Unknown keys are
+ * ignored, like g_key_file_get_*() never asking for them.
+ */
+
+/* FNV-1a with a seed picked so the known keys don't collide in the top
+ * six bits. Adding a key may need a new seed, test-keyfile checks that
+ * every key finds its own slot. */
+#define KEYFILE_HASH_SEED 89350
+#define KEYFILE_HASH_BITS 6
+
+static const struct {
+	const char *name;
+	enum keyfile_key key;
+} keywords[1 << KEYFILE_HASH_BITS] = {
+	[1] = { "Reversible", KF_REVERSIBLE },
+	[2] = { "Axes", KF_AXES },
+	[3] = { "Styli", KF_STYLI },
+	[4] = { "Buttons", KF_BUTTONS },
+	[5] = { "StatusLEDs", KF_STATUS_LEDS },
+	[7] = { "Right", KF_RIGHT },
+	[10] = { "HasLens", KF_HAS_LENS },
+	[12] = { "Touchstrip2", KF_TOUCHSTRIP2 },
+	[15] = { "OLEDs", KF_OLEDS },
+	[16] = { "HasWheel", KF_HAS_WHEEL },
+	[18] = { "PairedID", KF_PAIRED_ID },
+	[19] = { "Height", KF_HEIGHT },
+	[20] = { "RingNumModes", KF_RING_NUM_MODES },
+	[22] = { "Type", KF_TYPE },
+	[23] = { "EvdevCodes", KF_EVDEV_CODES },
+	[24] = { "KeyCodes", KF_KEY_CODES },
+	[26] = { "Bottom", KF_BOTTOM },
+	[28] = { "Group", KF_GROUP },
+	[30] = { "Ring2", KF_RING2 },
+	[31] = { "Left", KF_LEFT },
+	[33] = { "IntegratedIn", KF_INTEGRATED_IN },
+	[34] = { "DeviceMatch", KF_DEVICE_MATCH },
+	[36] = { "Ring", KF_RING },
+	[37] = { "ModelName", KF_MODEL_NAME },
+	[40] = { "Layout", KF_LAYOUT },
+	[42] = { "Touchstrip", KF_TOUCHSTRIP },
+	[43] = { "StripsNumModes", KF_STRIPS_NUM_MODES },
+	[44] = { "Width", KF_WIDTH },
+	[45] = { "PairedStylusIds", KF_PAIRED_STYLUS_IDS },
+	[47] = { "Stylus", KF_STYLUS },
+	[50] = { "EraserType", KF_ERASER_TYPE },
+	[51] = { "Ring2NumModes", KF_RING2_NUM_MODES },
+	[54] = { "Touch", KF_TOUCH },
+	[56] = { "Class", KF_CLASS },
+	[57] = { "Name", KF_NAME },
+	[58] = { "Top", KF_TOP },
+	[59] = { "TouchSwitch", KF_TOUCH_SWITCH },
+	[63] = { "NumStrips", KF_NUM_STRIPS },
+};
+
+enum keyfile_key
+libwacom_keyfile_lookup_key(const char *key, size_t len)
+{
+	uint32_t hash = KEYFILE_HASH_SEED;
+	const char *name;
+
+	for (size_t i = 0; i < len; i++) {
+		hash ^= (unsigned char)key[i];
+		hash *= 16777619;
+	}
+
+	name = keywords[hash >> (32 - KEYFILE_HASH_BITS)].name;
+	if (!name || strncmp(name, key, len) != 0 || name[len] != '\0')
+		return KF_UNKNOWN;
+
+	return keywords[hash >> (32 - KEYFILE_HASH_BITS)].key;
+}
+
+static size_t
+keyfile_get_section_index(struct keyfile *keyfile, const char *name)
+{
+	struct keyfile_section section = { .name = name };
+
+	/* Repeated groups are merged like GKeyFile does */
+	for (guint i = 0; i < keyfile->sections->len; i++) {
+		if (g_str_equal(g_array_index(keyfile->sections, struct keyfile_section, i).name, name))
+			return i;
+	}
+
+	g_array_append_val(keyfile->sections, section);
+
+	return keyfile->sections->len - 1;
+}
+
+/* Group lines may have trailing whitespace after the ] */
+static char *
+keyfile_parse_group(char *line)
+{
+	char *end = strchr(line, ']');
+
+	if (line[0] != '[' || !end)
+		return NULL;
+
+	for (const char *p = end + 1; *p; p++) {
+		if (*p != ' ' && *p != '\t')
+			return NULL;
+	}
+
+	*end = '\0';
+
+	return line + 1;
+}
+
+bool
+libwacom_keyfile_load(struct keyfile *keyfile, const char *path, GError **error)
+{
+	char *line, *next;
+	size_t section = 0;
+	bool in_section = false;
+
+	keyfile->sections = g_array_new(FALSE, FALSE, sizeof(struct keyfile_section));
+	if (!g_file_get_contents(path, &keyfile->contents, NULL, error)) {
+		keyfile->contents = NULL;
+		return false;
+	}
+
+	for (line = keyfile->contents; line; line = next) {
+		char *group, *equals, *key_end, *value;
+		enum keyfile_key key;
+		size_t len;
+
+		next = strchr(line, '\n');
+		if (next)
+			*next++ = '\0';
+
+		len = strlen(line);
+		if (len > 0 && line[len - 1] == '\r')
+			line[len - 1] = '\0';
+
+		while (g_ascii_isspace(*line))
+			line++;
+
+		if (*line == '\0' || *line == '#')
+			continue;
+
+		group = keyfile_parse_group(line);
+		if (group) {
+			section = keyfile_get_section_index(keyfile, group);
+			in_section = true;
+			continue;
+		}
+
+		equals = strchr(line, '=');
+		if (!equals) {
+			g_set_error(error, G_KEY_FILE_ERROR, G_KEY_FILE_ERROR_PARSE,
+				    "Key file contains line “%s” which is not "
+				    "a key-value pair, group, or comment", line);
+			return false;
+		}
+
+		if (!in_section) {
+			g_set_error_literal(error, G_KEY_FILE_ERROR, G_KEY_FILE_ERROR_GROUP_NOT_FOUND,
+					    "Key file does not start with a group");
+			return false;
+		}
+
+		/* Whitespace around the = is not part of the key or value */
+		for (key_end = equals; key_end > line && g_ascii_isspace(key_end[-1]); key_end--)
+			;
+		for (value = equals + 1; g_ascii_isspace(*value); value++)
+			;
+
+		key = libwacom_keyfile_lookup_key(line, key_end - line);
+		if (key != KF_UNKNOWN)
+			g_array_index(keyfile->sections, struct keyfile_section, section).values[key] = value;
+	}
+
+	return true;
+}
+
+void
+libwacom_keyfile_release(struct keyfile *keyfile)
+{
+	g_array_free(keyfile->sections, TRUE);
+	g_free(keyfile->contents);
+}
+
+const struct keyfile_section *
+libwacom_keyfile_get_section(const struct keyfile *keyfile, const char *name)
+{
+	for (guint i = 0; i < keyfile->sections->len; i++) {
+		const struct keyfile_section *section;
+
+		section = &g_array_index(keyfile->sections, struct keyfile_section, i);
+		if (g_str_equal(section->name, name))
+			return section;
+	}
+
+	return NULL;
+}
+
+/* Like GKeyFile, unknown escapes make the whole value invalid and \; is
+ * only valid in lists */
+static bool
+keyfile_escapes_valid(const char *value, bool list)
+{
+	for (const char *p = value; *p; p++) {
+		if (*p != '\\')
+			continue;
+
+		switch (*++p) {
+		case 's':
+		case 'n':
+		case 't':
+		case 'r':
+		case '\\':
+			break;
+		case ';':
+			if (list)
+				break;
+			return false;
+		default:
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static inline char
+keyfile_unescape(char c)
+{
+	switch (c) {
+	case 's': return ' ';
+	case 'n': return '\n';
+	case 't': return '\t';
+	case 'r': return '\r';
+	default: return c;
+	}
+}
+
+/* Unescapes up to the end of the value or, if separator is set, the
+ * next unescaped ';'. The escapes must have been checked with
+ * keyfile_escapes_valid(). Returns the start of the rest of the value */
+static char *
+keyfile_unescape_in_place(char *str, bool separator)
+{
+	char *src = str, *dst = str;
+
+	while (*src && !(separator && *src == ';')) {
+		if (src[0] == '\\') {
+			*dst++ = keyfile_unescape(src[1]);
+			src += 2;
+		} else {
+			*dst++ = *src++;
+		}
+	}
+
+	if (*src)
+		src++;
+	*dst = '\0';
+
+	return src;
+}
+
+char *
+libwacom_keyfile_get_string(const struct keyfile_section *section,
+			    enum keyfile_key key)
+{
+	char *value = section ? section->values[key] : NULL;
+
+	if (!value || !keyfile_escapes_valid(value, false))
+		return NULL;
+
+	keyfile_unescape_in_place(value, false);
+
+	return value;
+}
+
+char *
+libwacom_keyfile_get_list(const struct keyfile_section *section,
+			  enum keyfile_key key)
+{
+	char *value = section ? section->values[key] : NULL;
+
+	if (!value || !keyfile_escapes_valid(value, true))
+		return NULL;
+
+	return value;
+}
+
+/* cursor starts at the value returned by libwacom_keyfile_get_list() */
+char *
+libwacom_keyfile_list_next(char **cursor)
+{
+	char *item = *cursor;
+
+	/* Like g_key_file_get_string_list(), a trailing ; doesn't add an
+	 * empty item */
+	if (!item || *item == '\0')
+		return NULL;
+
+	*cursor = keyfile_unescape_in_place(item, true);
+
+	return item;
+}
+
+size_t
+libwacom_keyfile_list_max_length(const char *value)
+{
+	size_t count = 1;
+
+	if (!value)
+		return 0;
+
+	for (const char *p = value; *p; p++) {
+		if (*p == ';')
+			count++;
+	}
+
+	return count;
+}
+
+bool
+libwacom_keyfile_get_integer(const struct keyfile_section *section,
+			     enum keyfile_key key, int *value)
+{
+	const char *str = section ? section->values[key] : NULL;
+	char *end;
+	long v;
+
+	*value = 0;
+
+	if (!str || *str == '\0')
+		return false;
+
+	errno = 0;
+	v = strtol(str, &end, 10);
+	if ((*end != '\0' && !g_ascii_isspace(*end)) ||
+	    errno == ERANGE || v < INT_MIN || v > INT_MAX)
+		return false;
+
+	*value = v;
+
+	return true;
+}
+
+bool
+libwacom_keyfile_get_boolean(const struct keyfile_section *section,
+			     enum keyfile_key key, bool *value)
+{
+	const char *str = section ? section->values[key] : NULL;
+	size_t len;
+
+	*value = false;
+
+	if (!str)
+		return false;
+
+	len = strlen(str);
+	while (len > 0 && g_ascii_isspace(str[len - 1]))
+		len--;
+
+	if ((len == 4 && strncmp(str, "true", len) == 0) ||
+	    (len == 1 && str[0] == '1')) {
+		*value = true;
+		return true;
+	}
+
+	return (len == 5 && strncmp(str, "false", len) == 0) ||
+	       (len == 1 && str[0] == '0');
+}
+
+/* vim: set noexpandtab tabstop=8 shiftwidth=8: */
@@ -0,0 +1,180 @@
+/*
+ * Copyright © 2026 Red Hat, Inc.
+ *
+ * Permission to use, copy, modify, distribute, and sell this software
+ * and its documentation for any purpose is hereby granted without
+ * fee, provided that the above copyright notice appear in all copies
+ * and that both that copyright notice and this permission notice
+ * appear in supporting documentation, and that the name of Red Hat
+ * not be used in advertising or publicity pertaining to distribution
+ * of the software without specific, written prior permission.  Red
+ * Hat makes no representations about the suitability of this software
+ * for any purpose.  It is provided "as is" without express or implied
+ * warranty.
+ *
+ * THE AUTHORS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS SOFTWARE,
+ * INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS, IN
+ * NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS
+ * OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT,
+ * NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <sys/stat.h>
+#include <time.h>
+
+#include "libwacomint.h"
+
+static inline uint64_t
+now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* Statistics start disabled, see libwacom_database_new_for_paths() */
+void
+libwacom_stats_init(WacomDeviceDatabase *db)
+{
+	db->stats.enabled = false;
+	g_mutex_init(&db->stats.lock);
+}
+
+void
+libwacom_stats_clear(WacomDeviceDatabase *db)
+{
+	g_mutex_clear(&db->stats.lock);
+}
+
+/* Returns the start timestamp for a later libwacom_stats_add() of a
+ * time, or 0 if statistics are disabled */
+uint64_t
+libwacom_stats_start(const WacomDeviceDatabase *db)
+{
+	return db->stats.enabled ? now_ns() : 0;
+}
+
+static uint64_t *
+stats_counter(struct database_stats *stats, WacomDatabaseStat stat)
+{
+	switch (stat) {
+	case WSTAT_FILES_PARSED:	return &stats->files_parsed;
+	case WSTAT_BYTES_PARSED:	return &stats->bytes_parsed;
+	case WSTAT_PARSE_TIME:		return &stats->parse_time;
+	case WSTAT_PARSE_TIME_MAX:	return &stats->parse_time_max;
+	case WSTAT_LOAD_TIME:		return &stats->load_time;
+	case WSTAT_DEVICES_CREATED:	return &stats->devices_created;
+	case WSTAT_PATH_LOOKUPS:	return &stats->path_lookups;
+	case WSTAT_PATH_LOOKUP_TIME:	return &stats->path_lookup_time;
+	case WSTAT_UDEV_QUERIES:	return &stats->udev_queries;
+	default:
+		return NULL;
+	}
+}
+
+/* For times, value is the start timestamp from libwacom_stats_start() */
+void
+libwacom_stats_add(const WacomDeviceDatabase *db, WacomDatabaseStat stat, uint64_t value)
+{
+	struct database_stats *stats = (struct database_stats *)&db->stats;
+	uint64_t *counter;
+
+	if (!stats->enabled)
+		return;
+
+	switch (stat) {
+	case WSTAT_PARSE_TIME:
+	case WSTAT_LOAD_TIME:
+	case WSTAT_PATH_LOOKUP_TIME:
+		value = now_ns() - value;
+		break;
+	default:
+		break;
+	}
+
+	counter = stats_counter(stats, stat);
+	g_return_if_fail(counter != NULL);
+
+	g_mutex_lock(&stats->lock);
+	*counter += value;
+	g_mutex_unlock(&stats->lock);
+}
+
+/* The data files are parsed in parallel with WDATABASE_PARALLEL */
+void
+libwacom_stats_file_parsed(const WacomDeviceDatabase *db, const char *path, uint64_t start)
+{
+	struct database_stats *stats = (struct database_stats *)&db->stats;
+	struct stat st;
+	uint64_t elapsed;
+
+	if (!stats->enabled)
+		return;
+
+	elapsed = now_ns() - start;
+	if (stat(path, &st) != 0)
+		st.st_size = 0;
+
+	g_mutex_lock(&stats->lock);
+	stats->files_parsed++;
+	stats->bytes_parsed += st.st_size;
+	stats->parse_time += elapsed;
+	stats->parse_time_max = MAX(stats->parse_time_max, elapsed);
+	g_mutex_unlock(&stats->lock);
+}
+
+static uint64_t
+table_size(const WacomDeviceDatabase *db, WacomDatabaseStat stat)
+{
+	switch (stat) {
+	case WSTAT_NUM_MATCHES:
+		return g_hash_table_size(db->device_ht);
+	case WSTAT_NUM_PENDING_MATCHES:
+		return db->pending_ht ? g_hash_table_size(db->pending_ht) : 0;
+	case WSTAT_NUM_NAMES:
+		return g_hash_table_size(db->name_ht);
+	case WSTAT_NUM_STYLI:
+		return g_hash_table_size(db->stylus_ht);
+	default:
+		return 0;
+	}
+}
+
+LIBWACOM_EXPORT uint64_t
+libwacom_database_get_stat(const WacomDeviceDatabase *db, WacomDatabaseStat stat)
+{
+	struct database_stats *stats = (struct database_stats *)&db->stats;
+	uint64_t *counter;
+	uint64_t value;
+
+	/* Lazy loading changes the tables from other threads */
+	switch (stat) {
+	case WSTAT_NUM_MATCHES:
+	case WSTAT_NUM_PENDING_MATCHES:
+	case WSTAT_NUM_NAMES:
+	case WSTAT_NUM_STYLI:
+		libwacom_database_lock(db);
+		value = table_size(db, stat);
+		libwacom_database_unlock(db);
+		return value;
+	default:
+		break;
+	}
+
+	counter = stats_counter(stats, stat);
+	if (!counter || !stats->enabled)
+		return 0;
+
+	g_mutex_lock(&stats->lock);
+	value = *counter;
+	g_mutex_unlock(&stats->lock);
+
+	return value;
+}
+
+/* vim: set noexpandtab tabstop=8 shiftwidth=8: */
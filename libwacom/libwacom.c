@@ -32,6 +32,7 @@
 #include <stdbool.h>
 #include <stdio.h>
 #include <string.h>
+#include <sys/stat.h>
 #include <gudev/gudev.h>
 #include <libevdev/libevdev.h>
 
@@ -42,7 +43,7 @@
 static const WacomDevice *
 libwacom_get_device(const WacomDeviceDatabase *db, const char *match)
 {
-	return (WacomDevice *) g_hash_table_lookup (db->device_ht, match);
+	return libwacom_database_get_device (db, match);
 }
 
 static gboolean
@@ -212,8 +213,245 @@ client_query_by_subsystem_and_device_file (GUdevClient *client,
 	return ret;
 }
 
+/* The database keeps one udev client and the udev devices for the device
+ * files looked up so far. Entries are dropped on uevents for their device
+ * file. Since the uevents are only dispatched if the caller runs a main
+ * loop, entries are also checked against the device file before use. */
+struct udev_cache {
+	gint refcnt; /* shared by the snapshots of a database */
+	GUdevClient *client;
+	GHashTable *devices; /* key = device file (str), value = GUdevDevice * */
+	/* libudev isn't thread-safe, this protects the client, the devices
+	 * and everything read from them */
+	GMutex lock;
+};
+
+static void
+udev_cache_uevent (GUdevClient *client,
+		   const char  *action,
+		   GUdevDevice *device,
+		   gpointer     data)
+{
+	struct udev_cache *cache = data;
+	const char *devnode;
+
+	devnode = g_udev_device_get_device_file (device);
+	if (devnode) {
+		g_mutex_lock (&cache->lock);
+		g_hash_table_remove (cache->devices, devnode);
+		g_mutex_unlock (&cache->lock);
+	}
+}
+
+struct udev_cache *
+libwacom_udev_cache_ref (struct udev_cache *cache)
+{
+	g_atomic_int_inc (&cache->refcnt);
+	return cache;
+}
+
+void
+libwacom_udev_cache_unref (struct udev_cache *cache)
+{
+	if (!cache || !g_atomic_int_dec_and_test (&cache->refcnt))
+		return;
+
+	g_signal_handlers_disconnect_by_data (cache->client, cache);
+	g_object_unref (cache->client);
+	g_hash_table_destroy (cache->devices);
+	g_mutex_clear (&cache->lock);
+	g_free (cache);
+}
+
+static struct udev_cache *
+udev_cache_get (const WacomDeviceDatabase *db)
+{
+	const char * const subsystems[] = { "input", NULL };
+	struct udev_cache *cache;
+
+	libwacom_database_lock (db);
+
+	cache = db->udev_cache;
+	if (!cache) {
+		cache = g_new0 (struct udev_cache, 1);
+		cache->refcnt = 1;
+		g_mutex_init (&cache->lock);
+		cache->client = g_udev_client_new (subsystems);
+		cache->devices = g_hash_table_new_full (g_str_hash, g_str_equal,
+							g_free, g_object_unref);
+		g_signal_connect (cache->client, "uevent",
+				  G_CALLBACK (udev_cache_uevent), cache);
+
+		/* The cache is invisible to the caller, like lazy loading */
+		((WacomDeviceDatabase *) db)->udev_cache = cache;
+	}
+
+	libwacom_database_unlock (db);
+
+	return cache;
+}
+
+/* A device file that was removed and re-created for a different device
+ * has the same device number but the new device has a new sysfs path */
+static gboolean
+udev_device_is_current (GUdevDevice *device, const char *path)
+{
+	struct stat st;
+
+	if (stat (path, &st) != 0 ||
+	    g_udev_device_get_device_number (device) != st.st_rdev)
+		return FALSE;
+
+	return g_file_test (g_udev_device_get_sysfs_path (device), G_FILE_TEST_EXISTS);
+}
+
+/* Adds all input devices with a device file with a single enumeration,
+ * called with cache->lock held */
+static void
+udev_cache_prime (struct udev_cache *cache)
+{
+	GList *l, *devices;
+
+	devices = g_udev_client_query_by_subsystem (cache->client, "input");
+	for (l = devices; l != NULL; l = l->next) {
+		const char *devnode = g_udev_device_get_device_file (l->data);
+
+		if (devnode)
+			g_hash_table_replace (cache->devices, g_strdup (devnode),
+					      g_object_ref (l->data));
+		g_object_unref (l->data);
+	}
+	g_list_free (devices);
+}
+
+/* Called with cache->lock held */
+static GUdevDevice *
+udev_cache_lookup (const WacomDeviceDatabase *db, struct udev_cache *cache,
+		   const char *path)
+{
+	GUdevDevice *device;
+
+	device = g_hash_table_lookup (cache->devices, path);
+	if (device && udev_device_is_current (device, path))
+		return g_object_ref (device);
+
+	libwacom_stats_add (db, WSTAT_UDEV_QUERIES, 1);
+
+	device = client_query_by_subsystem_and_device_file (cache->client, "input", path);
+	if (device == NULL)
+		device = g_udev_client_query_by_device_file (cache->client, path);
+
+	if (device)
+		g_hash_table_replace (cache->devices, g_strdup (path), g_object_ref (device));
+	else
+		g_hash_table_remove (cache->devices, path);
+
+	return device;
+}
+
+static WacomIntegrationFlags
+integration_flags_from_properties (const char *properties)
+{
+	int flag;
+
+	flag = atoi(properties);
+	flag &= (1 << INPUT_PROP_DIRECT) | (1 << INPUT_PROP_POINTER);
+	/*
+	 * To ensure we are dealing with a screen tablet, need
+	 * to check that it has DIRECT and non-POINTER (DIRECT
+	 * alone is not sufficient since it's set for drawing
+	 * tablets as well)
+	 */
+	if (flag == (1 << INPUT_PROP_DIRECT))
+		return WACOM_DEVICE_INTEGRATED_DISPLAY;
+
+	return WACOM_DEVICE_INTEGRATED_NONE;
+}
+
+/* Resolves an event node without enumerating the udev devices: the device
+ * number is a direct lookup of the event device, its parent is the input
+ * device with the ids and the name. Returns FALSE if anything is missing
+ * or unusual, the caller then falls back to the full GUdev lookup. */
 static gboolean
-get_device_info (const char            *path,
+get_device_info_from_device_number (const WacomDeviceDatabase *db,
+				    const char            *path,
+				    int                   *vendor_id,
+				    int                   *product_id,
+				    char                 **name,
+				    WacomBusType          *bus,
+				    WacomIntegrationFlags *integration_flags)
+{
+	struct udev_cache *cache;
+	struct stat st;
+	GUdevDevice *device, *parent = NULL;
+	const char *bustype, *vendor, *product, *properties;
+	gboolean retval = FALSE;
+
+	if (stat (path, &st) != 0 || !S_ISCHR (st.st_mode))
+		return FALSE;
+
+	cache = udev_cache_get (db);
+	g_mutex_lock (&cache->lock);
+
+	device = g_udev_client_query_by_device_number (cache->client,
+						       G_UDEV_DEVICE_TYPE_CHAR,
+						       st.st_rdev);
+	/* Touchpads are only for the "Finger" part of Bamboo devices,
+	 * anything that isn't tagged itself needs the parent checks */
+	if (!device || !is_tablet_or_touchpad (device))
+		goto out;
+
+	parent = g_udev_device_get_parent (device);
+	if (!parent)
+		goto out;
+
+	bustype = g_udev_device_get_sysfs_attr (parent, "id/bustype");
+	vendor = g_udev_device_get_sysfs_attr (parent, "id/vendor");
+	product = g_udev_device_get_sysfs_attr (parent, "id/product");
+	*name = g_strdup (g_udev_device_get_sysfs_attr (parent, "name"));
+	if (!bustype || !vendor || !product || !*name)
+		goto out;
+
+	/* Same bus types as get_bus_vid_pid() */
+	switch (strtoul (bustype, NULL, 16)) {
+	case 3:
+		*bus = WBUSTYPE_USB;
+		break;
+	case 5:
+		*bus = WBUSTYPE_BLUETOOTH;
+		break;
+	case 24:
+		*bus = WBUSTYPE_I2C;
+		break;
+	default:
+		goto out;
+	}
+	*vendor_id = (int)strtol (vendor, NULL, 16);
+	*product_id = (int)strtol (product, NULL, 16);
+
+	properties = g_udev_device_get_sysfs_attr (parent, "properties");
+	*integration_flags = properties ?
+			     integration_flags_from_properties (properties) :
+			     WACOM_DEVICE_INTEGRATED_UNSET;
+
+	retval = TRUE;
+
+out:
+	if (!retval) {
+		g_free (*name);
+		*name = NULL;
+	}
+	g_clear_object (&parent);
+	g_clear_object (&device);
+	g_mutex_unlock (&cache->lock);
+
+	return retval;
+}
+
+static gboolean
+get_device_info (const WacomDeviceDatabase *db,
+		 gboolean               try_device_number,
+		 const char            *path,
 		 int                   *vendor_id,
 		 int                   *product_id,
 		 char                 **name,
@@ -221,9 +459,8 @@ get_device_info (const char            *path,
 		 WacomIntegrationFlags *integration_flags,
 		 WacomError            *error)
 {
-	GUdevClient *client;
+	struct udev_cache *cache;
 	GUdevDevice *device;
-	const char * const subsystems[] = { "input", NULL };
 	gboolean retval;
 	char *bus_str;
 	const char *devname;
@@ -233,10 +470,17 @@ get_device_info (const char            *path,
 	*integration_flags = WACOM_DEVICE_INTEGRATED_UNSET;
 	*name = NULL;
 	bus_str = NULL;
-	client = g_udev_client_new (subsystems);
-	device = client_query_by_subsystem_and_device_file (client, subsystems[0], path);
-	if (device == NULL)
-		device = g_udev_client_query_by_device_file (client, path);
+
+	if (try_device_number &&
+	    get_device_info_from_device_number (db, path, vendor_id, product_id,
+						name, bus, integration_flags))
+		return TRUE;
+
+	/* The device is shared with other threads through the cache */
+	cache = udev_cache_get (db);
+	g_mutex_lock (&cache->lock);
+
+	device = udev_cache_lookup (db, cache, path);
 	if (device == NULL) {
 		libwacom_error_set(error, WERROR_INVALID_PATH, "Could not find device '%s' in udev", path);
 		goto out;
@@ -262,21 +506,7 @@ get_device_info (const char            *path,
 
 		sysfs_path = g_build_filename ("/sys/class/input", devname, "device/properties", NULL);
 		if (g_file_get_contents (sysfs_path, &contents, NULL, NULL)) {
-			int flag;
-
-			flag = atoi(contents);
-			flag &= (1 << INPUT_PROP_DIRECT) | (1 << INPUT_PROP_POINTER);
-			/*
-			 * To ensure we are dealing with a screen tablet, need
-			 * to check that it has DIRECT and non-POINTER (DIRECT
-			 * alone is not sufficient since it's set for drawing
-			 * tablets as well)
-			 */
-			if (flag == (1 << INPUT_PROP_DIRECT))
-				*integration_flags = WACOM_DEVICE_INTEGRATED_DISPLAY;
-			else
-				*integration_flags = WACOM_DEVICE_INTEGRATED_NONE;
-
+			*integration_flags = integration_flags_from_properties (contents);
 			g_free (contents);
 		}
 		g_free (sysfs_path);
@@ -321,75 +551,32 @@ out:
 		g_free (*name);
 	if (device != NULL)
 		g_object_unref (device);
-	if (client != NULL)
-		g_object_unref (client);
+	g_mutex_unlock (&cache->lock);
 	return retval;
 }
 
+/* Devices handed out to the caller are views of the database device:
+ * they share everything with it except for the default match, the
+ * integration flags and the name, which the caller may override. */
 static WacomDevice *
-libwacom_copy(const WacomDevice *device)
+libwacom_new_view(const WacomDevice *device)
 {
+	WacomDevice *base = device->base ? device->base : (WacomDevice *)device;
 	WacomDevice *d;
-	GHashTableIter iter;
-	gpointer k, v;
-
-	d = g_new0 (WacomDevice, 1);
-	g_atomic_int_inc(&d->refcnt);
-	d->name = g_strdup (device->name);
-	d->model_name = g_strdup (device->model_name);
-	d->width = device->width;
-	d->height = device->height;
-	d->integration_flags = device->integration_flags;
-	d->layout = g_strdup(device->layout);
-	d->matches = g_array_sized_new(TRUE, TRUE, sizeof(WacomDevice*),
-				       device->matches->len);
-	for (guint i = 0; i < device->matches->len; i++) {
-		WacomMatch *m = g_array_index(device->matches, WacomMatch*, i);
-		libwacom_match_ref(m);
-		g_array_append_val(d->matches, m);
-	}
+
+	d = g_memdup2 (device, sizeof(*d));
+	d->refcnt = 1;
+	d->base = libwacom_ref(base);
 	d->match = libwacom_match_ref(device->match);
-	if (device->paired)
-		d->paired = libwacom_match_ref(device->paired);
-	d->cls = device->cls;
-	d->num_strips = device->num_strips;
-	d->features = device->features;
-	d->strips_num_modes = device->strips_num_modes;
-	d->ring_num_modes = device->ring_num_modes;
-	d->ring2_num_modes = device->ring2_num_modes;
-	d->styli = g_array_sized_new(FALSE, FALSE, sizeof(int),
-				     device->styli->len);
-	for (guint i = 0; i < device->styli->len; i++) {
-		int id = g_array_index(device->styli, int, i);
-		g_array_append_val(d->styli, id);
-	}
-	d->status_leds = g_array_sized_new(FALSE, FALSE,
-					   sizeof(WacomStatusLEDs),
-					   device->status_leds->len);
-	for (guint i = 0; i < device->status_leds->len; i++) {
-		g_array_append_val(d->status_leds,
-				   g_array_index(device->status_leds, WacomStatusLEDs, i));
-	}
-
-	d->buttons = g_hash_table_new_full(g_direct_hash, g_direct_equal,
-					   NULL, g_free);
-	g_hash_table_iter_init(&iter, device->buttons);
-	while (g_hash_table_iter_next(&iter, &k, &v)) {
-		WacomButton *a = v;
-		WacomButton *b = g_memdup2(a, sizeof(WacomButton));
-		g_hash_table_insert(d->buttons, k, b);
-	}
-
-	d->num_keycodes = device->num_keycodes;
-	memcpy(d->keycodes, device->keycodes, sizeof(device->keycodes));
 
 	return d;
 }
 
+/* Matches of the same database share interned strings */
 static bool
 match_is_equal(const WacomMatch *a, const WacomMatch *b)
 {
-	return g_str_equal(a->match, b->match);
+	return a->match == b->match || g_str_equal(a->match, b->match);
 }
 
 static bool
@@ -439,12 +626,93 @@ libwacom_same_layouts (const WacomDevice *a, const WacomDevice *b)
 	return rc;
 }
 
+/* 64-bit FNV-1a */
+static uint64_t
+hash_bytes(uint64_t hash, const void *data, size_t len)
+{
+	const unsigned char *p = data;
+
+	for (size_t i = 0; i < len; i++) {
+		hash ^= p[i];
+		hash *= 0x100000001b3ULL;
+	}
+
+	return hash;
+}
+
+static inline uint64_t
+hash_int(uint64_t hash, int64_t value)
+{
+	return hash_bytes(hash, &value, sizeof(value));
+}
+
+static inline uint64_t
+hash_string(uint64_t hash, const char *str)
+{
+	if (!str)
+		return hash_int(hash, -1);
+
+	return hash_bytes(hash, str, strlen(str) + 1);
+}
+
+#define HASH_SEED 0xcbf29ce484222325ULL
+
+void
+libwacom_match_update_hash(WacomMatch *match)
+{
+	match->hash = hash_string(HASH_SEED, match->match);
+}
+
+/* Must be called whenever a field libwacom_compare() looks at changes,
+ * other than the matches. Devices that compare equal have the same
+ * hash. */
+void
+libwacom_update_hash(WacomDevice *device)
+{
+	const char *layout = device->layout;
+	uint64_t hash = HASH_SEED;
+
+	/* Layouts are compared by file name */
+	if (layout && strrchr(layout, '/'))
+		layout = strrchr(layout, '/') + 1;
+
+	hash = hash_string(hash, device->name);
+	hash = hash_int(hash, device->width);
+	hash = hash_int(hash, device->height);
+	hash = hash_string(hash, layout);
+	hash = hash_int(hash, device->integration_flags);
+	hash = hash_int(hash, device->cls);
+	hash = hash_int(hash, device->num_strips);
+	hash = hash_int(hash, device->features);
+	hash = hash_int(hash, device->strips_num_modes);
+	hash = hash_int(hash, device->ring_num_modes);
+	hash = hash_int(hash, device->ring2_num_modes);
+	hash = hash_int(hash, device->num_buttons);
+	hash = hash_bytes(hash, device->styli, device->num_styli * sizeof(int));
+	hash = hash_int(hash, device->num_styli);
+	hash = hash_bytes(hash, device->status_leds,
+			  device->num_status_leds * sizeof(WacomStatusLEDs));
+	hash = hash_int(hash, device->num_status_leds);
+	for (int i = 0; i < NUM_BUTTONS; i++) {
+		hash = hash_int(hash, device->buttons[i].flags);
+		hash = hash_int(hash, device->buttons[i].code);
+	}
+	hash = hash_int(hash, device->paired ? (int64_t)device->paired->hash : -1);
+
+	device->hash = hash;
+}
+
+LIBWACOM_EXPORT uint64_t
+libwacom_hash(const WacomDevice *device)
+{
+	g_return_val_if_fail(device, 0);
+
+	return device->hash ^ (device->match ? device->match->hash * 0x9e3779b97f4a7c15ULL : 0);
+}
+
 LIBWACOM_EXPORT int
 libwacom_compare(const WacomDevice *a, const WacomDevice *b, WacomCompareFlags flags)
 {
-	GHashTableIter iter;
-	gpointer k, v;
-
 	g_return_val_if_fail(a || b, 0);
 
 	if (!a || !b)
@@ -453,6 +721,16 @@ libwacom_compare(const WacomDevice *a, const WacomDevice *b, WacomCompareFlags f
 	if (a == b)
 		return 0;
 
+	/* Only devices with the same hash can be equal */
+	if (a->hash != b->hash)
+		return 1;
+
+	/* The default match is compared below either way. The hash check
+	 * is skipped with WCOMPARE_MATCHES only because the full match
+	 * comparison follows. */
+	if (!(flags & WCOMPARE_MATCHES) && a->match->hash != b->match->hash)
+		return 1;
+
 	if (!g_str_equal(a->name, b->name))
 		return 1;
 
@@ -483,31 +761,24 @@ libwacom_compare(const WacomDevice *a, const WacomDevice *b, WacomCompareFlags f
 	if (a->ring2_num_modes != b->ring2_num_modes)
 		return 1;
 
-	if (g_hash_table_size(a->buttons) != g_hash_table_size(b->buttons))
+	if (a->num_buttons != b->num_buttons)
 		return 1;
 
-	if (a->styli->len != b->styli->len)
+	if (a->num_styli != b->num_styli)
 		return 1;
 
-	if (memcmp(a->styli->data, b->styli->data, sizeof(int) * a->styli->len) != 0)
+	if (memcmp(a->styli, b->styli, sizeof(int) * a->num_styli) != 0)
 		return 1;
 
-	if (a->status_leds->len != b->status_leds->len)
+	if (a->num_status_leds != b->num_status_leds)
 		return 1;
 
-	if (a->status_leds->len > 0 &&
-	    memcmp(a->status_leds->data, b->status_leds->data,
-		   sizeof(WacomStatusLEDs) * a->status_leds->len) != 0)
+	if (memcmp(a->status_leds, b->status_leds,
+		   sizeof(WacomStatusLEDs) * a->num_status_leds) != 0)
 		return 1;
 
-	g_hash_table_iter_init(&iter, a->buttons);
-	while (g_hash_table_iter_next(&iter, &k, &v)) {
-		WacomButton *ba = v;
-		WacomButton *bb = g_hash_table_lookup(b->buttons, k);
-
-		if (!bb || ba->flags != bb->flags || ba->code != bb->code)
-			return 1;
-	}
+	if (memcmp(a->buttons, b->buttons, sizeof(a->buttons)) != 0)
+		return 1;
 
 	if ((a->paired == NULL && b->paired != NULL) ||
 	    (a->paired != NULL && b->paired == NULL) ||
@@ -525,31 +796,111 @@ libwacom_compare(const WacomDevice *a, const WacomDevice *b, WacomCompareFlags f
 static const WacomDevice *
 libwacom_new (const WacomDeviceDatabase *db, const char *name, int vendor_id, int product_id, WacomBusType bus, WacomError *error)
 {
-	const WacomDevice *device;
-	char *match;
-
 	if (!db) {
 		libwacom_error_set(error, WERROR_INVALID_DB, "db is NULL");
 		return NULL;
 	}
 
-	match = make_match_string(name, bus, vendor_id, product_id);
-	device = libwacom_get_device(db, match);
-	g_free (match);
+	return libwacom_database_lookup(db, name, bus, vendor_id, product_id);
+}
+
+/* The database device for the device info, NULL if there is none.
+ * match_name is set to the name the device was found with, generic is
+ * set if it is the generic fallback device. */
+static const WacomDevice *
+find_device_info (const WacomDeviceDatabase *db,
+		  int vendor_id, int product_id, const char *name,
+		  WacomBusType bus, WacomFallbackFlags fallback,
+		  const char **match_name, gboolean *generic,
+		  WacomError *error)
+{
+	const WacomDevice *device;
+
+	*generic = FALSE;
+	*match_name = name;
+	device = libwacom_new (db, *match_name, vendor_id, product_id, bus, error);
+	if (device == NULL) {
+		*match_name = NULL;
+		device = libwacom_new (db, *match_name, vendor_id, product_id, bus, error);
+	}
+
+	if (device == NULL && fallback == WFALLBACK_GENERIC) {
+		device = libwacom_get_device(db, "generic");
+		*generic = device != NULL;
+	}
 
 	return device;
 }
 
+/* Creates the view for a device found by find_device_info() */
+static WacomDevice *
+new_from_found_device (const WacomDeviceDatabase *db, const WacomDevice *device,
+		       const char *match_name, gboolean generic,
+		       int vendor_id, int product_id, const char *name,
+		       WacomBusType bus, WacomIntegrationFlags integration_flags,
+		       WacomError *error)
+{
+	WacomDevice *ret = NULL;
+	WacomMatch *match;
+
+	if (device == NULL)
+		goto out;
+
+	ret = libwacom_new_view(device);
+
+	/* freed in libwacom_unref() */
+	if (generic && name != NULL) {
+		ret->name = g_strdup(name);
+		libwacom_update_hash(ret);
+	}
+
+	/* for multiple-match devices, set to the one we requested */
+	match = libwacom_match_new(NULL, match_name, bus, vendor_id, product_id);
+	libwacom_set_default_match(ret, match);
+	libwacom_match_unref(match);
+
+	/* if unset, use the kernel flags. Could be unset as well. */
+	if (ret->integration_flags == WACOM_DEVICE_INTEGRATED_UNSET) {
+		ret->integration_flags = integration_flags;
+		libwacom_update_hash(ret);
+	}
+
+out:
+	if (ret == NULL)
+		libwacom_error_set(error, WERROR_UNKNOWN_MODEL, "unknown model");
+	else
+		libwacom_stats_add(db, WSTAT_DEVICES_CREATED, 1);
+	return ret;
+}
+
+static WacomDevice *
+new_from_device_info (const WacomDeviceDatabase *db,
+		      int vendor_id, int product_id, const char *name,
+		      WacomBusType bus, WacomIntegrationFlags integration_flags,
+		      WacomFallbackFlags fallback, WacomError *error)
+{
+	const WacomDevice *device;
+	const char *match_name;
+	gboolean generic;
+
+	device = find_device_info (db, vendor_id, product_id, name, bus, fallback,
+				   &match_name, &generic, error);
+
+	return new_from_found_device (db, device, match_name, generic,
+				      vendor_id, product_id, name, bus,
+				      integration_flags, error);
+}
+
 LIBWACOM_EXPORT WacomDevice*
 libwacom_new_from_path(const WacomDeviceDatabase *db, const char *path, WacomFallbackFlags fallback, WacomError *error)
 {
 	int vendor_id, product_id;
 	WacomBusType bus;
-	const WacomDevice *device;
-	WacomDevice *ret = NULL;
+	WacomDevice *ret;
 	WacomIntegrationFlags integration_flags;
-	char *name, *match_name;
-	WacomMatch *match;
+	char *name;
+	gboolean found;
+	uint64_t start;
 
 	switch (fallback) {
 		case WFALLBACK_NONE:
@@ -570,51 +921,166 @@ libwacom_new_from_path(const WacomDeviceDatabase *db, const char *path, WacomFal
 		return NULL;
 	}
 
-	if (!get_device_info (path, &vendor_id, &product_id, &name, &bus, &integration_flags, error))
+	start = libwacom_stats_start (db);
+	found = get_device_info (db, TRUE, path, &vendor_id, &product_id, &name, &bus, &integration_flags, error);
+	libwacom_stats_add (db, WSTAT_PATH_LOOKUPS, 1);
+	libwacom_stats_add (db, WSTAT_PATH_LOOKUP_TIME, start);
+	if (!found)
 		return NULL;
 
-	match_name = name;
-	device = libwacom_new (db, match_name, vendor_id, product_id, bus, error);
-	if (device == NULL) {
-		match_name = NULL;
-		device = libwacom_new (db, match_name, vendor_id, product_id, bus, error);
+	ret = new_from_device_info (db, vendor_id, product_id, name, bus,
+				    integration_flags, fallback, error);
+	g_free (name);
+
+	return ret;
+}
+
+struct path_info {
+	gboolean resolved;
+	int vendor_id;
+	int product_id;
+	char *name;
+	WacomBusType bus;
+	WacomIntegrationFlags integration_flags;
+};
+
+LIBWACOM_EXPORT WacomDevice**
+libwacom_new_from_paths(const WacomDeviceDatabase *db, const char **paths, size_t npaths,
+			WacomFallbackFlags fallback, WacomError *error)
+{
+	struct path_info *infos;
+	WacomDevice **devices;
+	GHashTable *groups;
+	gboolean need_udev = FALSE;
+	uint64_t start;
+
+	switch (fallback) {
+		case WFALLBACK_NONE:
+		case WFALLBACK_GENERIC:
+			break;
+		default:
+			libwacom_error_set(error, WERROR_BUG_CALLER, "invalid fallback flags");
+			return NULL;
 	}
 
-	if (device == NULL) {
-		if (fallback == WFALLBACK_NONE)
-			goto out;
+	if (!db) {
+		libwacom_error_set(error, WERROR_INVALID_DB, "db is NULL");
+		return NULL;
+	}
 
-		/* WFALLBACK_GENERIC */
-		device = libwacom_get_device(db, "generic");
-		if (device == NULL)
-			goto out;
+	if (!paths) {
+		libwacom_error_set(error, WERROR_INVALID_PATH, "paths is NULL");
+		return NULL;
+	}
 
-		ret = libwacom_copy(device);
+	infos = g_new0 (struct path_info, npaths);
+	devices = calloc (npaths + 1, sizeof (*devices));
+	if (!devices) {
+		g_free (infos);
+		libwacom_error_set(error, WERROR_BAD_ALLOC, "Memory allocation failed");
+		return NULL;
+	}
 
-		if (name != NULL) {
-			g_free (ret->name);
-			ret->name = g_strdup(name);
-		}
-	} else {
-		ret = libwacom_copy(device);
+	start = libwacom_stats_start (db);
+
+	for (size_t i = 0; i < npaths; i++) {
+		struct path_info *info = &infos[i];
+
+		if (!paths[i])
+			continue;
+
+		info->resolved = get_device_info_from_device_number (db, paths[i],
+								     &info->vendor_id,
+								     &info->product_id,
+								     &info->name,
+								     &info->bus,
+								     &info->integration_flags);
+		need_udev |= !info->resolved;
 	}
 
-	/* for multiple-match devices, set to the one we requested */
-	match = libwacom_match_new(match_name, bus, vendor_id, product_id);
-	libwacom_set_default_match(ret, match);
-	libwacom_match_unref(match);
+	/* One enumeration for all nodes the device number didn't resolve */
+	if (need_udev) {
+		struct udev_cache *cache = udev_cache_get (db);
 
-	/* if unset, use the kernel flags. Could be unset as well. */
-	if (device && ret->integration_flags == WACOM_DEVICE_INTEGRATED_UNSET)
-		ret->integration_flags = integration_flags;
+		g_mutex_lock (&cache->lock);
+		udev_cache_prime (cache);
+		g_mutex_unlock (&cache->lock);
+		libwacom_stats_add (db, WSTAT_UDEV_QUERIES, 1);
+	}
 
-out:
-	g_free (name);
-	if (ret == NULL)
-		libwacom_error_set(error, WERROR_UNKNOWN_MODEL, "unknown model");
-	return ret;
+	/* The pen, pad and touch nodes of a tablet have different names but
+	 * typically resolve to the same database device. Nodes that end up
+	 * with an identical view share one device reference. */
+	groups = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+	for (size_t i = 0; i < npaths; i++) {
+		struct path_info *info = &infos[i];
+		const WacomDevice *found;
+		WacomDevice *device;
+		const char *match_name;
+		gboolean generic;
+		WacomIntegrationFlags integration_flags;
+		char *key;
+
+		if (!paths[i])
+			continue;
+
+		if (!info->resolved)
+			info->resolved = get_device_info (db, FALSE, paths[i],
+							  &info->vendor_id,
+							  &info->product_id,
+							  &info->name,
+							  &info->bus,
+							  &info->integration_flags,
+							  NULL);
+		libwacom_stats_add (db, WSTAT_PATH_LOOKUPS, 1);
+		if (!info->resolved)
+			continue;
+
+		found = find_device_info (db, info->vendor_id, info->product_id,
+					  info->name, info->bus, fallback,
+					  &match_name, &generic, NULL);
+		if (!found)
+			continue;
+
+		/* Everything new_from_found_device() takes from the node:
+		 * the default match, the integration flags if the database
+		 * doesn't have them and the name of a generic device */
+		integration_flags = found->integration_flags;
+		if (integration_flags == WACOM_DEVICE_INTEGRATED_UNSET)
+			integration_flags = info->integration_flags;
+		key = g_strdup_printf ("%p:%d:%04x:%04x:%s:%u:%s", (void *)found,
+				       info->bus, info->vendor_id, info->product_id,
+				       match_name ? match_name : "",
+				       integration_flags,
+				       generic && info->name ? info->name : "");
+		device = g_hash_table_lookup (groups, key);
+		if (device) {
+			devices[i] = libwacom_ref (device);
+			g_free (key);
+			continue;
+		}
+
+		devices[i] = new_from_found_device (db, found, match_name, generic,
+						    info->vendor_id, info->product_id,
+						    info->name, info->bus,
+						    info->integration_flags, NULL);
+		if (devices[i])
+			g_hash_table_insert (groups, key, devices[i]);
+		else
+			g_free (key);
+	}
+	libwacom_stats_add (db, WSTAT_PATH_LOOKUP_TIME, start);
+
+	for (size_t i = 0; i < npaths; i++)
+		g_free (infos[i].name);
+	g_free (infos);
+	g_hash_table_destroy (groups);
+
+	return devices;
 }
 
+
 LIBWACOM_EXPORT WacomDevice*
 libwacom_new_from_usbid(const WacomDeviceDatabase *db, int vendor_id, int product_id, WacomError *error)
 {
@@ -631,8 +1097,10 @@ libwacom_new_from_usbid(const WacomDeviceDatabase *db, int vendor_id, int produc
 	if (!device)
 		device = libwacom_new(db, NULL, vendor_id, product_id, WBUSTYPE_BLUETOOTH, error);
 
-	if (device)
-		return libwacom_copy(device);
+	if (device) {
+		libwacom_stats_add(db, WSTAT_DEVICES_CREATED, 1);
+		return libwacom_new_view(device);
+	}
 
 	libwacom_error_set(error, WERROR_UNKNOWN_MODEL, NULL);
 	return NULL;
@@ -642,7 +1110,6 @@ LIBWACOM_EXPORT WacomDevice*
 libwacom_new_from_name(const WacomDeviceDatabase *db, const char *name, WacomError *error)
 {
 	const WacomDevice *device;
-	GList *keys, *l;
 
 	if (!db) {
 		libwacom_error_set(error, WERROR_INVALID_DB, "db is NULL");
@@ -651,20 +1118,16 @@ libwacom_new_from_name(const WacomDeviceDatabase *db, const char *name, WacomErr
 
 	g_return_val_if_fail(name != NULL, NULL);
 
-	device = NULL;
-	keys = g_hash_table_get_values (db->device_ht);
-	for (l = keys; l; l = l->next) {
-		WacomDevice *d = l->data;
+	libwacom_database_load_pending(db);
 
-		if (g_str_equal(d->name, name)) {
-			device = d;
-			break;
-		}
-	}
-	g_list_free (keys);
+	device = g_hash_table_lookup (db->name_ht, name);
+	if (!device)
+		device = g_hash_table_lookup (db->model_name_ht, name);
 
-	if (device)
-		return libwacom_copy(device);
+	if (device) {
+		libwacom_stats_add(db, WSTAT_DEVICES_CREATED, 1);
+		return libwacom_new_view(device);
+	}
 
 	libwacom_error_set(error, WERROR_UNKNOWN_MODEL, NULL);
 	return NULL;
@@ -899,7 +1362,7 @@ libwacom_print_device_description(int fd, const WacomDevice *device)
 WacomDevice *
 libwacom_ref(WacomDevice *device)
 {
-	assert(device->refcnt >= 1);
+	assert(g_atomic_int_get(&device->refcnt) >= 1);
 
 	g_atomic_int_inc(&device->refcnt);
 	return device;
@@ -911,24 +1374,41 @@ libwacom_unref(WacomDevice *device)
 	if (device == NULL)
 		return NULL;
 
-	assert(device->refcnt >= 1);
+	assert(g_atomic_int_get(&device->refcnt) >= 1);
 
 	if (!g_atomic_int_dec_and_test(&device->refcnt))
 		return NULL;
 
-	g_free (device->name);
-	g_free (device->model_name);
-	g_free (device->layout);
+	if (device->base) {
+		if (device->name != device->base->name)
+			g_free (device->name);
+		libwacom_match_unref(device->match);
+		libwacom_unref(device->base);
+		g_free (device);
+		return NULL;
+	}
+
 	if (device->paired)
 		libwacom_match_unref(device->paired);
-	for (guint i = 0; i < device->matches->len; i++)
-		libwacom_match_unref(g_array_index(device->matches, WacomMatch*, i));
-	g_array_free (device->matches, TRUE);
+	for (int i = 0; i < device->num_matches; i++)
+		libwacom_match_unref(device->matches[i]);
 	libwacom_match_unref(device->match);
-	g_array_free (device->styli, TRUE);
-	g_array_free (device->status_leds, TRUE);
-	if (device->buttons)
-		g_hash_table_destroy (device->buttons);
+
+	/* The device itself may live in the arena, so this goes last */
+	if (device->arena) {
+		libwacom_arena_unref(device->arena);
+		return NULL;
+	}
+
+	if (device->image)
+		g_mapped_file_unref(device->image);
+	else {
+		g_free (device->name);
+		g_free (device->model_name);
+	}
+	g_free (device->layout);
+	g_free (device->matches);
+	g_free (device->styli);
 	g_free (device);
 
 	return NULL;
@@ -954,31 +1434,54 @@ libwacom_match_unref(WacomMatch *match)
 	    !g_atomic_int_dec_and_test(&match->refcnt))
 		return NULL;
 
-	g_free (match->match);
-	g_free (match->name);
+	if (match->arena) {
+		libwacom_arena_unref(match->arena);
+		return NULL;
+	}
+
+	if (match->image) {
+		g_mapped_file_unref(match->image);
+	} else {
+		g_free (match->match);
+		g_free (match->name);
+	}
 	g_free (match);
 
 	return NULL;
 }
 
+/* If arena is set, the match is allocated from it */
 WacomMatch*
-libwacom_match_new(const char *name, WacomBusType bus, int vendor_id, int product_id)
+libwacom_match_new(struct arena *arena, const char *name,
+		   WacomBusType bus, int vendor_id, int product_id)
 {
 	WacomMatch *match;
 	char *newmatch;
 
-	match = g_malloc(sizeof(*match));
+	if (arena)
+		match = libwacom_arena_alloc0(arena, sizeof(*match));
+	else
+		match = g_malloc(sizeof(*match));
 	match->refcnt = 1;
 	if (name == NULL && bus == WBUSTYPE_UNKNOWN && vendor_id == 0 && product_id == 0)
 		newmatch = g_strdup("generic");
 	else
 		newmatch = make_match_string(name, bus, vendor_id, product_id);
 
-	match->match = newmatch;
-	match->name = g_strdup(name);
+	if (arena) {
+		match->match = libwacom_arena_take(arena, newmatch);
+		match->name = libwacom_arena_intern(arena, name);
+		match->arena = libwacom_arena_ref(arena);
+	} else {
+		match->match = newmatch;
+		match->name = g_strdup(name);
+		match->arena = NULL;
+	}
 	match->bus = bus;
 	match->vendor_id = vendor_id;
 	match->product_id = product_id;
+	match->image = NULL;
+	libwacom_match_update_hash(match);
 
 	return match;
 }
@@ -986,23 +1489,37 @@ libwacom_match_new(const char *name, WacomBusType bus, int vendor_id, int produc
 void
 libwacom_add_match(WacomDevice *device, WacomMatch *newmatch)
 {
-	for (guint i = 0; i < device->matches->len; i++) {
-		WacomMatch *m = g_array_index(device->matches, WacomMatch *, i);
+	for (int i = 0; i < device->num_matches; i++) {
+		WacomMatch *m = device->matches[i];
 		const char *matchstr = libwacom_match_get_match_string(m);
 
 		if (g_str_equal(matchstr, newmatch->match)) {
 			return;
 		}
 	}
-	libwacom_match_ref(newmatch);
-	g_array_append_val(device->matches, newmatch);
+	/* Devices have few matches, so this grows the array one by one.
+	 * In the arena the old array is only freed with the arena. */
+	if (device->arena) {
+		WacomMatch **matches;
+
+		matches = libwacom_arena_alloc0(device->arena,
+						(device->num_matches + 2) * sizeof(*matches));
+		if (device->num_matches > 0)
+			memcpy(matches, device->matches,
+			       device->num_matches * sizeof(*matches));
+		device->matches = matches;
+	} else {
+		device->matches = g_renew(WacomMatch*, device->matches, device->num_matches + 2);
+	}
+	device->matches[device->num_matches++] = libwacom_match_ref(newmatch);
+	device->matches[device->num_matches] = NULL;
 }
 
 void
 libwacom_set_default_match(WacomDevice *device, WacomMatch *newmatch)
 {
-	for (guint i = 0; i < device->matches->len; i++) {
-		WacomMatch *m = g_array_index(device->matches, WacomMatch *, i);
+	for (int i = 0; i < device->num_matches; i++) {
+		WacomMatch *m = device->matches[i];
 
 		if (match_is_equal(m, newmatch)) {
 			libwacom_match_unref(device->match);
@@ -1016,19 +1533,19 @@ libwacom_set_default_match(WacomDevice *device, WacomMatch *newmatch)
 void
 libwacom_remove_match(WacomDevice *device, WacomMatch *to_remove)
 {
-	for (guint i= 0; i < device->matches->len; i++) {
-		WacomMatch *m = g_array_index(device->matches, WacomMatch*, i);
+	for (int i = 0; i < device->num_matches; i++) {
+		WacomMatch *m = device->matches[i];
 		if (match_is_equal(m, to_remove)) {
 			WacomMatch *dflt = device->match;
 
-			/* remove from list */
-			g_array_remove_index(device->matches, i);
+			/* remove from list, including the NULL terminator */
+			memmove(&device->matches[i], &device->matches[i + 1],
+				(device->num_matches - i) * sizeof(WacomMatch*));
+			device->num_matches--;
 
 			/* now reset the default match if needed */
 			if (match_is_equal(dflt, to_remove)) {
-				WacomMatch *first = g_array_index(device->matches,
-							      WacomMatch*,
-							      0);
+				WacomMatch *first = device->matches[0];
 				libwacom_set_default_match(device, first);
 			}
 
@@ -1080,7 +1597,12 @@ libwacom_get_match(const WacomDevice *device)
 LIBWACOM_EXPORT const WacomMatch**
 libwacom_get_matches(const WacomDevice *device)
 {
-	return (const WacomMatch**)device->matches->data;
+	static const WacomMatch *no_matches[] = { NULL };
+
+	if (!device->matches)
+		return no_matches;
+
+	return (const WacomMatch**)device->matches;
 }
 
 LIBWACOM_EXPORT const WacomMatch*
@@ -1119,10 +1641,20 @@ libwacom_has_touch(const WacomDevice *device)
 	return !!(device->features & FEATURE_TOUCH);
 }
 
+/* NULL if button is not a button letter */
+static inline const WacomButton *
+get_button(const WacomDevice *device, char button)
+{
+	if (button < 'A' || button >= 'A' + NUM_BUTTONS)
+		return NULL;
+
+	return &device->buttons[button - 'A'];
+}
+
 LIBWACOM_EXPORT int
 libwacom_get_num_buttons(const WacomDevice *device)
 {
-	return g_hash_table_size(device->buttons);
+	return device->num_buttons;
 }
 
 LIBWACOM_EXPORT int
@@ -1134,8 +1666,8 @@ libwacom_get_num_keys(const WacomDevice *device)
 LIBWACOM_EXPORT const int *
 libwacom_get_supported_styli(const WacomDevice *device, int *num_styli)
 {
-	*num_styli = device->styli->len;
-	return (const int *)device->styli->data;
+	*num_styli = device->num_styli;
+	return device->styli;
 }
 
 LIBWACOM_EXPORT int
@@ -1177,8 +1709,8 @@ libwacom_get_strips_num_modes(const WacomDevice *device)
 LIBWACOM_EXPORT const WacomStatusLEDs *
 libwacom_get_status_leds(const WacomDevice *device, int *num_leds)
 {
-	*num_leds = device->status_leds->len;
-	return (const WacomStatusLEDs*)device->status_leds->data;
+	*num_leds = device->num_status_leds;
+	return device->status_leds;
 }
 
 static const struct {
@@ -1194,19 +1726,16 @@ static const struct {
 LIBWACOM_EXPORT int
 libwacom_get_button_led_group (const WacomDevice *device, char button)
 {
-	WacomButton *b = g_hash_table_lookup(device->buttons,
-					     GINT_TO_POINTER(button));
+	const WacomButton *b = get_button(device, button);
 
-	if (!(b->flags & WACOM_BUTTON_MODESWITCH))
+	if (!b || !(b->flags & WACOM_BUTTON_MODESWITCH))
 		return -1;
 
-	for (guint led_index = 0; led_index < device->status_leds->len; led_index++) {
+	for (int led_index = 0; led_index < device->num_status_leds; led_index++) {
 		guint n;
 
 		for (n = 0; n < G_N_ELEMENTS (button_status_leds); n++) {
-			WacomStatusLEDs led = g_array_index(device->status_leds,
-							    WacomStatusLEDs,
-							    led_index);
+			WacomStatusLEDs led = device->status_leds[led_index];
 			if ((b->flags & button_status_leds[n].button_flags) &&
 			    (led == button_status_leds[n].status_leds)) {
 				return led_index;
@@ -1255,9 +1784,7 @@ libwacom_get_bustype(const WacomDevice *device)
 LIBWACOM_EXPORT WacomButtonFlags
 libwacom_get_button_flag(const WacomDevice *device, char button)
 {
-	WacomButton *b = g_hash_table_lookup(device->buttons,
-					     GINT_TO_POINTER(button));
-
+	const WacomButton *b = get_button(device, button);
 
 	return b ? b->flags : WACOM_BUTTON_NONE;
 }
@@ -1265,8 +1792,7 @@ libwacom_get_button_flag(const WacomDevice *device, char button)
 LIBWACOM_EXPORT int
 libwacom_get_button_evdev_code(const WacomDevice *device, char button)
 {
-	WacomButton *b = g_hash_table_lookup(device->buttons,
-					     GINT_TO_POINTER(button));
+	const WacomButton *b = get_button(device, button);
 
 	return b ? b->code : 0;
 }
@@ -1293,8 +1819,8 @@ LIBWACOM_EXPORT const int *
 libwacom_stylus_get_paired_ids(const WacomStylus *stylus, int *num_paired_ids)
 {
 	if (num_paired_ids)
-		*num_paired_ids = stylus->paired_ids->len;
-	return (const int*)stylus->paired_ids->data;
+		*num_paired_ids = stylus->num_paired_ids;
+	return stylus->paired_ids;
 }
 
 LIBWACOM_EXPORT int
@@ -1425,10 +1951,18 @@ libwacom_stylus_unref(WacomStylus *stylus)
 	if (!g_atomic_int_dec_and_test(&stylus->refcnt))
 		return NULL;
 
-	g_free (stylus->name);
-	g_free (stylus->group);
-	if (stylus->paired_ids)
-		g_array_free (stylus->paired_ids, TRUE);
+	if (stylus->arena) {
+		libwacom_arena_unref(stylus->arena);
+		return NULL;
+	}
+
+	if (stylus->image) {
+		g_mapped_file_unref(stylus->image);
+	} else {
+		g_free (stylus->name);
+		g_free (stylus->group);
+	}
+	g_free (stylus->paired_ids);
 	g_free (stylus);
 
 	return NULL;
@@ -71,6 +71,28 @@
 
  For a full API reference to see libwacom.h.
 
+ @section Threads
+
+ A database may be used from multiple threads at the same time without
+ locking by the caller. This includes all functions that look up
+ devices or styli in the database, e.g. libwacom_new_from_path(),
+ libwacom_new_from_usbid(), libwacom_stylus_get_for_id(),
+ libwacom_list_devices_from_database() and
+ libwacom_database_get_devices(). Lookups in a fully loaded
+ database do not take any locks. Only a database created with
+ @ref WDATABASE_LAZY that has not parsed all tablet files yet, and
+ device paths that need a udev query, serialize on an internal lock.
+
+ libwacom_database_dispatch() and libwacom_database_destroy() must not
+ run concurrently with any other call on the same database. To look up
+ devices while another thread updates the database, each lookup thread
+ takes a snapshot with libwacom_database_get_snapshot(). Taking a
+ snapshot never waits for libwacom_database_dispatch() to parse files.
+
+ A device or error is only used by one thread at a time. Different
+ devices, including devices returned for the same model, may be used
+ and destroyed from different threads.
+
  @section Database
 
  libwacom comes with a database of models and their features in key-value
@@ -272,6 +294,55 @@ typedef enum {
 	WCOMPARE_MATCHES	= (1 << 1),	/**< compare all possible matches too */
 } WacomCompareFlags;
 
+/**
+ * Capabilities for libwacom_database_query_devices()
+ *
+ * @ingroup devices
+ */
+typedef enum {
+	WQUERY_STYLUS			= (1 << 0),	/**< see libwacom_has_stylus() */
+	WQUERY_TOUCH			= (1 << 1),	/**< see libwacom_has_touch() */
+	WQUERY_RING			= (1 << 2),	/**< see libwacom_has_ring() */
+	WQUERY_RING2			= (1 << 3),	/**< see libwacom_has_ring2() */
+	WQUERY_TOUCHSTRIP		= (1 << 4),	/**< at least one touch strip, see libwacom_get_num_strips() */
+	WQUERY_TOUCHSWITCH		= (1 << 5),	/**< see libwacom_has_touchswitch() */
+	WQUERY_REVERSIBLE		= (1 << 6),	/**< see libwacom_is_reversible() */
+	WQUERY_INTEGRATED_DISPLAY	= (1 << 7),	/**< see @ref WACOM_DEVICE_INTEGRATED_DISPLAY */
+	WQUERY_INTEGRATED_SYSTEM	= (1 << 8),	/**< see @ref WACOM_DEVICE_INTEGRATED_SYSTEM */
+} WacomQueryFlags;
+
+/**
+ * @ingroup context
+ */
+typedef enum {
+	WDATABASE_DEFAULT	= 0,		/**< load all data files on creation */
+	WDATABASE_LAZY		= (1 << 0),	/**< parse tablet files on first lookup */
+	WDATABASE_PARALLEL	= (1 << 1),	/**< parse data files in multiple threads */
+	WDATABASE_STATS		= (1 << 2),	/**< collect statistics, see libwacom_database_get_stat() */
+	WDATABASE_WATCH		= (1 << 3),	/**< watch the data directories, see libwacom_database_get_fd() */
+} WacomDatabaseFlags;
+
+/**
+ * Statistics for libwacom_database_get_stat(). Times are in nanoseconds.
+ *
+ * @ingroup context
+ */
+typedef enum {
+	WSTAT_FILES_PARSED,		/**< number of data files parsed */
+	WSTAT_BYTES_PARSED,		/**< total size of the data files parsed */
+	WSTAT_PARSE_TIME,		/**< total time spent parsing data files */
+	WSTAT_PARSE_TIME_MAX,		/**< longest time spent parsing a single data file */
+	WSTAT_LOAD_TIME,		/**< time spent creating the database */
+	WSTAT_NUM_MATCHES,		/**< number of DeviceMatch entries loaded */
+	WSTAT_NUM_PENDING_MATCHES,	/**< number of DeviceMatch entries not parsed yet, see @ref WDATABASE_LAZY */
+	WSTAT_NUM_NAMES,		/**< number of distinct device names */
+	WSTAT_NUM_STYLI,		/**< number of styli loaded */
+	WSTAT_DEVICES_CREATED,		/**< number of devices returned by the libwacom_new_*() functions */
+	WSTAT_PATH_LOOKUPS,		/**< number of device paths resolved by libwacom_new_from_path() */
+	WSTAT_PATH_LOOKUP_TIME,		/**< total time spent resolving device paths */
+	WSTAT_UDEV_QUERIES,		/**< number of device paths that needed a udev query */
+} WacomDatabaseStat;
+
 /**
  * @ingroup devices
  */
@@ -341,7 +412,71 @@ WacomDeviceDatabase* libwacom_database_new(void);
 WacomDeviceDatabase* libwacom_database_new_for_path(const char *datadir);
 
 /**
- * Free all memory used by the database.
+ * Loads the Tablet and Stylus databases like libwacom_database_new().
+ *
+ * With @ref WDATABASE_LAZY, only the DeviceMatch entries of each tablet
+ * file are read when the database is created. A tablet file is parsed the
+ * first time one of its matches is looked up, e.g. by
+ * libwacom_new_from_path(). Functions that need all devices, e.g.
+ * libwacom_list_devices_from_database(), parse all remaining files.
+ *
+ * With @ref WDATABASE_PARALLEL, the data files are parsed in multiple
+ * threads. The resulting database is identical to one loaded with
+ * @ref WDATABASE_DEFAULT. This flag has no effect in combination with
+ * @ref WDATABASE_LAZY.
+ *
+ * With @ref WDATABASE_WATCH, the database watches its data directories
+ * and can be updated with libwacom_database_dispatch(). The data files
+ * are always parsed on creation, @ref WDATABASE_LAZY has no effect in
+ * combination with this flag.
+ *
+ * @param flags A bitmask of @ref WacomDatabaseFlags
+ * @return A new database or NULL on error.
+ *
+ * @ingroup context
+ */
+WacomDeviceDatabase* libwacom_database_new_with_flags(WacomDatabaseFlags flags);
+
+/**
+ * Loads the Tablet and Stylus databases from the prefix path passed,
+ * see libwacom_database_new_with_flags().
+ *
+ * @param datadir The data directory to load the data files from
+ * @param flags A bitmask of @ref WacomDatabaseFlags
+ * @return A new database or NULL on error.
+ *
+ * @ingroup context
+ */
+WacomDeviceDatabase* libwacom_database_new_for_path_with_flags(const char *datadir,
+							       WacomDatabaseFlags flags);
+
+/**
+ * Loads the Tablet and Stylus databases from a database image as
+ * written by libwacom-update-cache.
+ *
+ * The image is mapped read-only and the device, match and stylus strings
+ * are used directly from the mapping, so processes using the same image
+ * share the memory for the strings. The devices, styli and lookup tables
+ * are still built in each process, without parsing any data file. Run
+ * the bench-database benchmark to see the memory this saves. Unlike
+ * libwacom_database_new(), the image is used as-is and is not checked
+ * against the data files.
+ *
+ * The image file must not be modified while the database or any device
+ * created from it exists. libwacom-update-cache replaces the file instead
+ * of modifying it.
+ *
+ * @param path The path to the database image
+ * @return A new database or NULL on error.
+ *
+ * @ingroup context
+ */
+WacomDeviceDatabase* libwacom_database_new_from_image(const char *path);
+
+/**
+ * Free all memory used by the database. A database returned by
+ * libwacom_database_get_snapshot() is only freed once all references to
+ * it are destroyed.
  *
  * @param db A Tablet and Stylus database.
  *
@@ -349,6 +484,79 @@ WacomDeviceDatabase* libwacom_database_new_for_path(const char *datadir);
  */
 void libwacom_database_destroy(WacomDeviceDatabase *db);
 
+/**
+ * Return a statistic about the cost of this database, e.g. how many data
+ * files were parsed and how long that took. The table sizes (e.g.
+ * @ref WSTAT_NUM_MATCHES) are always available, all other statistics are
+ * only collected if the database was created with @ref WDATABASE_STATS
+ * and are 0 otherwise.
+ *
+ * @param db A Tablet and Stylus database.
+ * @param stat The statistic to return
+ * @return The current value of the statistic
+ *
+ * @ingroup context
+ */
+uint64_t libwacom_database_get_stat(const WacomDeviceDatabase *db, WacomDatabaseStat stat);
+
+/**
+ * Return a file descriptor that becomes readable when a data file is
+ * added, changed or removed. Once readable, call
+ * libwacom_database_dispatch() to update the database.
+ *
+ * Only databases created with @ref WDATABASE_WATCH have a file
+ * descriptor. Data directories that do not exist when the database is
+ * created are not watched.
+ *
+ * @param db A Tablet and Stylus database.
+ * @return A file descriptor or -1 if the database does not watch its data
+ * directories
+ *
+ * @ingroup context
+ */
+int libwacom_database_get_fd(const WacomDeviceDatabase *db);
+
+/**
+ * Update the database for the data files that changed since the last
+ * call, see libwacom_database_get_fd(). Only the changed tablet files are
+ * parsed again, a change to a stylus file parses all files again.
+ *
+ * Devices previously returned by the libwacom_new_*() functions stay
+ * valid but are not updated, use libwacom_new_from_path() or similar to
+ * get the current data. Styli returned by libwacom_stylus_get_for_id()
+ * for db stay valid until a change to a stylus file is dispatched, styli
+ * returned for a snapshot stay valid until the snapshot is destroyed.
+ *
+ * @param db A Tablet and Stylus database.
+ * @return The number of tablet files parsed or -1 on error
+ *
+ * @ingroup context
+ */
+int libwacom_database_dispatch(WacomDeviceDatabase *db);
+
+/**
+ * Return the current state of the database as a database that never
+ * changes. The snapshot can be used with all lookup functions, e.g.
+ * libwacom_new_from_path() or libwacom_stylus_get_for_id(), and must be
+ * released with libwacom_database_destroy().
+ *
+ * For a database created with @ref WDATABASE_WATCH, each
+ * libwacom_database_dispatch() that changes the database publishes a
+ * new snapshot. Snapshots taken earlier keep the previous data until
+ * they are destroyed. Destroying db does not invalidate its snapshots.
+ *
+ * For any other database, the snapshot is another reference to db.
+ *
+ * This function may be called from any thread, including while another
+ * thread runs libwacom_database_dispatch() on db.
+ *
+ * @param db A Tablet and Stylus database.
+ * @return A snapshot of the database
+ *
+ * @ingroup context
+ */
+WacomDeviceDatabase* libwacom_database_get_snapshot(const WacomDeviceDatabase *db);
+
 /**
  * Create a new device reference from the given device path.
  * In case of error, NULL is returned and the error is set to the
@@ -365,6 +573,31 @@ void libwacom_database_destroy(WacomDeviceDatabase *db);
  */
 WacomDevice* libwacom_new_from_path(const WacomDeviceDatabase *db, const char *path, WacomFallbackFlags fallback, WacomError *error);
 
+/**
+ * Create new device references for a set of device paths at once, e.g.
+ * all event nodes of a tablet. This is equivalent to calling
+ * libwacom_new_from_path() for each path but the system is queried only
+ * once for all paths. Paths that resolve to the same database device with
+ * the same match and integration flags share one reference, typically
+ * the pen, pad and touch nodes of a tablet.
+ *
+ * The returned array has npaths entries, entry i is the device for
+ * paths[i] or NULL if that path could not be resolved. Each non-NULL
+ * entry must be freed with libwacom_destroy(), the array itself with
+ * free().
+ *
+ * @param db A device database
+ * @param paths An array of device paths in the form of e.g. /dev/input/event0
+ * @param npaths The number of elements in paths
+ * @param fallback Whether we should create a generic if model is unknown
+ * @param error If not NULL, set to the error if any occurs
+ *
+ * @return An array of npaths device references or NULL on error.
+ *
+ * @ingroup devices
+ */
+WacomDevice** libwacom_new_from_paths(const WacomDeviceDatabase *db, const char **paths, size_t npaths, WacomFallbackFlags fallback, WacomError *error);
+
 /**
  * Create a new device reference from the given vendor/product IDs.
  * In case of error, NULL is returned and the error is set to the
@@ -389,6 +622,9 @@ WacomDevice* libwacom_new_from_usbid(const WacomDeviceDatabase *db, int vendor_i
  * In case of error, NULL is returned and the error is set to the
  * appropriate value.
  *
+ * The name is compared against the device names first and against the
+ * model names (see libwacom_get_model_name()) second.
+ *
  * @param db A device database
  * @param name The name identifying the device
  * @param error If not NULL, set to the error if any occurs
@@ -410,10 +646,74 @@ WacomDevice* libwacom_new_from_name(const WacomDeviceDatabase *db, const char *n
  * The content of the list is owned by the database and should not be
  * modified or freed. Use free() to free the list.
  *
+ * @see libwacom_database_get_devices
+ *
  * @ingroup devices
  */
 WacomDevice** libwacom_list_devices_from_database(const  WacomDeviceDatabase *db, WacomError *error);
 
+/**
+ * Returns the devices in the given database, in the same order as
+ * libwacom_list_devices_from_database().
+ *
+ * The list is built on the first call and owned by the database, later
+ * calls return it without allocating. It stays valid until the database
+ * is destroyed or, for a database created with @ref WDATABASE_WATCH,
+ * until the next libwacom_database_dispatch(). Use a snapshot, see
+ * libwacom_database_get_snapshot(), to keep the list across updates.
+ *
+ * @param db A device database
+ * @param[out] ndevices If not NULL, set to the number of devices
+ *
+ * @return A NULL terminated list of pointers to all the devices inside the
+ * database. Neither the list nor the devices may be modified or freed.
+ *
+ * @ingroup devices
+ */
+const WacomDevice * const *libwacom_database_get_devices(const WacomDeviceDatabase *db,
+							 int *ndevices);
+
+/**
+ * Looks up the devices in the given database that have all of the given
+ * capabilities and match the given class, bus and vendor. A device
+ * matches a bus or vendor if any of its matches does, see
+ * libwacom_get_matches().
+ *
+ * The query is answered from bitmaps built together with the list
+ * returned by libwacom_database_get_devices(), the devices themselves are
+ * not looked at. The devices are returned in the same order as in that
+ * list and with the same lifetime.
+ *
+ * For example, to find all built-in devices with a ring:
+ * <pre>
+ *      n = libwacom_database_query_devices(db,
+ *                                         WQUERY_RING | WQUERY_INTEGRATED_DISPLAY,
+ *                                         WCLASS_UNKNOWN, WBUSTYPE_UNKNOWN, -1,
+ *                                         devices, G_N_ELEMENTS(devices));
+ * </pre>
+ *
+ * @param db A device database
+ * @param flags The capabilities a device must have, 0 for any device
+ * @param cls The device class, or WCLASS_UNKNOWN for any class
+ * @param bus The bus type, or WBUSTYPE_UNKNOWN for any bus
+ * @param vendor_id The vendor ID, or -1 for any vendor
+ * @param[out] devices Filled with up to ndevices matching devices, may
+ * be NULL if ndevices is 0
+ * @param ndevices The number of elements in devices
+ *
+ * @return The number of matching devices, which may be more than
+ * ndevices.
+ *
+ * @ingroup devices
+ */
+int libwacom_database_query_devices(const WacomDeviceDatabase *db,
+				    WacomQueryFlags flags,
+				    WacomClass cls,
+				    WacomBusType bus,
+				    int vendor_id,
+				    const WacomDevice **devices,
+				    int ndevices);
+
 /**
  * Print the description of this device to the given file.
  *
@@ -443,10 +743,28 @@ void libwacom_destroy(WacomDevice *device);
  *
  * @return 0 if the devices are identical, nonzero otherwise
  *
+ * @see libwacom_hash
+ *
  * @ingroup devices
  */
 int libwacom_compare(const WacomDevice *a, const WacomDevice *b, WacomCompareFlags flags);
 
+/**
+ * Return a hash of the device. Devices that are identical according to
+ * libwacom_compare() with @ref WCOMPARE_NORMAL have the same hash, so
+ * the hash can be used to put devices into a hash table. The hash is
+ * computed when the device is created, calling this function is cheap.
+ *
+ * The hash may change between libwacom versions.
+ *
+ * @param device The device
+ *
+ * @return A hash of the device
+ *
+ * @ingroup devices
+ */
+uint64_t libwacom_hash(const WacomDevice *device);
+
 /**
  * @param device The tablet to query
  * @return The class of the device
@@ -30,6 +30,7 @@
 #define _LIBWACOMINT_H_
 
 #include "libwacom.h"
+#include <stdbool.h>
 #include <stdint.h>
 #include <glib.h>
 
@@ -39,6 +40,7 @@
 	printf(__VA_ARGS__)
 
 #define GENERIC_DEVICE_MATCH "generic"
+#define CACHE_FILENAME "libwacom.cache"
 #define WACOM_DEVICE_INTEGRATED_UNSET (WACOM_DEVICE_INTEGRATED_NONE - 1U)
 
 enum WacomFeature {
@@ -59,9 +61,16 @@ struct _WacomMatch {
 	WacomBusType bus;
 	uint32_t vendor_id;
 	uint32_t product_id;
+	uint64_t hash; /* of the match string, see libwacom_match_update_hash() */
+	GMappedFile *image; /* if set, strings point into the image */
+	struct arena *arena; /* if set, the match and its strings are allocated from the arena */
 };
 
-/* Used in the device->buttons hashtable */
+#define NUM_BUTTONS 26 /* 'A' to 'Z' */
+#define NUM_STATUS_LEDS 4 /* one of each WacomStatusLEDs */
+
+/* Used in the device->buttons array, a button the device doesn't have
+ * has WACOM_BUTTON_NONE flags */
 typedef struct _WacomButton {
 	WacomButtonFlags flags;
 	int code;
@@ -73,8 +82,8 @@ typedef struct _WacomKeycode {
 } WacomKeycode;
 
 /* WARNING: When adding new members to this struct
- * make sure to update libwacom_copy() and
- * libwacom_print_device_description() ! */
+ * make sure to update libwacom_print_device_description() and
+ * the cache in libwacom-cache.c ! */
 struct _WacomDevice {
 	char *name;
 	char *model_name;
@@ -82,7 +91,8 @@ struct _WacomDevice {
 	int height;
 
 	WacomMatch *match;	/* used match or first match by default */
-	GArray *matches;
+	WacomMatch **matches;	/* NULL-terminated */
+	int num_matches;
 
 	WacomMatch *paired;
 
@@ -95,15 +105,30 @@ struct _WacomDevice {
 	int ring_num_modes;
 	int ring2_num_modes;
 
-	GArray *styli;
-	GHashTable *buttons; /* 'A' : WacomButton */
+	int *styli;
+	int num_styli;
+	WacomButton buttons[NUM_BUTTONS]; /* index 0 is button 'A' */
+	int num_buttons;
 	WacomKeycode keycodes[32];
 	size_t num_keycodes;
 
-	GArray *status_leds;
+	WacomStatusLEDs status_leds[NUM_STATUS_LEDS];
+	int num_status_leds;
 
 	char *layout;
 
+	/* Everything libwacom_compare() looks at except the matches, see
+	 * libwacom_update_hash() */
+	uint64_t hash;
+
+	GMappedFile *image; /* if set, name and model_name point into the image */
+	struct arena *arena; /* if set, the device, its arrays and strings are allocated from the arena */
+
+	/* If set, this device is a view of the database device base, see
+	 * libwacom_new_view(). Only match, integration_flags and name
+	 * belong to the view, everything else is shared with base. */
+	WacomDevice *base;
+
 	gint refcnt; /* for the db hashtable */
 };
 
@@ -114,17 +139,132 @@ struct _WacomStylus {
 	char *group;
 	int num_buttons;
 	gboolean has_eraser;
-	GArray *paired_ids;
+	int *paired_ids;
+	int num_paired_ids;
 	WacomEraserType eraser_type;
 	gboolean has_lens;
 	gboolean has_wheel;
 	WacomStylusType type;
 	WacomAxisTypeFlags axes;
+	GMappedFile *image; /* if set, strings point into the image */
+	struct arena *arena; /* if set, the stylus, its paired IDs and strings are allocated from the arena */
+};
+
+struct pending_tablet;
+struct udev_cache;
+struct arena;
+struct device_index;
+
+/* WDATABASE_STATS only, lookups may come from any thread */
+struct database_stats {
+	bool enabled;
+	GMutex lock;
+	uint64_t files_parsed;
+	uint64_t bytes_parsed;
+	uint64_t parse_time;
+	uint64_t parse_time_max;
+	uint64_t load_time;
+	uint64_t devices_created;
+	uint64_t path_lookups;
+	uint64_t path_lookup_time;
+	uint64_t udev_queries;
 };
 
 struct _WacomDeviceDatabase {
+	gint refcnt; /* snapshots are shared, see libwacom_database_get_snapshot() */
 	GHashTable *device_ht; /* key = DeviceMatch (str), value = WacomDeviceData * */
+	/* Secondary index on device_ht, see libwacom_database_lookup() */
+	GHashTable *usbid_ht; /* key = packed bus/vid/pid (gint64 *), value = struct usbid_bucket * */
+	GHashTable *name_ht; /* key = device name (str), value = WacomDevice *, both borrowed */
+	GHashTable *model_name_ht; /* key = model name (str), value = WacomDevice *, both borrowed */
+	/* Unique devices of device_ht and bitmaps over them. Built on first
+	 * use, see libwacom_database_get_devices() */
+	struct device_index *index;
+	/* WDATABASE_LAZY only: tablet files that have not been parsed yet */
+	GHashTable *pending_ht; /* key = DeviceMatch (str), value = GPtrArray of the
+				 * struct pending_tablet * that have it, in precedence order */
+	GPtrArray *pending_tablets; /* struct pending_tablet *, owns the entries */
+	gint pending_done; /* atomic, set once pending_ht is empty */
 	GHashTable *stylus_ht; /* key = ID (int), value = WacomStylus * */
+	GMappedFile *image; /* if set, device_ht keys point into the image */
+	/* Everything parsed for this database is allocated from the arena,
+	 * device_ht keys are the interned match strings of their devices.
+	 * libwacom_database_dispatch() starts a new arena for each update. */
+	struct arena *arena;
+	struct udev_cache *udev_cache; /* created on first use by libwacom_new_from_path() */
+	struct database_stats stats;
+	/* WDATABASE_WATCH only, see libwacom_database_dispatch() */
+	char **datadirs;
+	GHashTable *tablet_files; /* key = path (str), value = struct tablet_file * */
+	GHashTable *match_files; /* key = DeviceMatch (str), value = struct tablet_file * owning the device_ht entry */
+	GHashTable *match_claims; /* key = DeviceMatch (str), value = GPtrArray of the
+				   * struct tablet_file * that have it, sorted by directory */
+	int watch_fd; /* inotify fd or -1 */
+	int *watches; /* inotify watch descriptor for each of datadirs */
+	WacomDeviceDatabase *snapshot; /* WDATABASE_WATCH only, the current generation */
+	/* Protects everything lookups change, i.e. the lazy loading, the
+	 * creation of udev_cache and the snapshot swap. Lookups in a fully loaded database
+	 * don't lock, see the Threads section in libwacom.h */
+	GMutex lock;
+};
+
+/* Keys in .tablet and .stylus files, see libwacom-keyfile.c */
+enum keyfile_key {
+	KF_UNKNOWN = -1,
+	/* [Device] */
+	KF_DEVICE_MATCH,
+	KF_PAIRED_ID,
+	KF_NAME,
+	KF_MODEL_NAME,
+	KF_WIDTH,
+	KF_HEIGHT,
+	KF_INTEGRATED_IN,
+	KF_LAYOUT,
+	KF_CLASS,
+	KF_STYLI,
+	/* [Features] */
+	KF_STYLUS,
+	KF_TOUCH,
+	KF_RING,
+	KF_RING2,
+	KF_REVERSIBLE,
+	KF_TOUCH_SWITCH,
+	KF_NUM_STRIPS,
+	KF_STATUS_LEDS,
+	/* [Buttons] */
+	KF_LEFT,
+	KF_RIGHT,
+	KF_TOP,
+	KF_BOTTOM,
+	KF_TOUCHSTRIP,
+	KF_TOUCHSTRIP2,
+	KF_OLEDS,
+	KF_EVDEV_CODES,
+	KF_RING_NUM_MODES,
+	KF_RING2_NUM_MODES,
+	KF_STRIPS_NUM_MODES,
+	/* [Keys] */
+	KF_KEY_CODES,
+	/* .stylus files */
+	KF_GROUP,
+	KF_ERASER_TYPE,
+	KF_PAIRED_STYLUS_IDS,
+	KF_HAS_LENS,
+	KF_HAS_WHEEL,
+	KF_BUTTONS,
+	KF_AXES,
+	KF_TYPE,
+	KF_NUM_KEYS,
+};
+
+struct keyfile_section {
+	const char *name;
+	char *values[KF_NUM_KEYS]; /* raw values in the file's buffer, NULL if unset */
+};
+
+struct keyfile {
+	char *contents;
+	GArray *sections; /* struct keyfile_section, in file order */
 };
 
 struct _WacomError {
@@ -143,13 +283,70 @@ void libwacom_error_set(WacomError *error, enum WacomErrorCode code, const char
 void libwacom_add_match(WacomDevice *device, WacomMatch *newmatch);
 void libwacom_set_default_match(WacomDevice *device, WacomMatch *newmatch);
 void libwacom_remove_match(WacomDevice *device, WacomMatch *newmatch);
-WacomMatch* libwacom_match_new(const char *name, WacomBusType bus,
+WacomMatch* libwacom_match_new(struct arena *arena, const char *name, WacomBusType bus,
 			       int vendor_id, int product_id);
+void libwacom_match_update_hash(WacomMatch *match);
+void libwacom_update_hash(WacomDevice *device);
 
 WacomBusType  bus_from_str (const char *str);
 const char   *bus_to_str   (WacomBusType bus);
 char *make_match_string(const char *name, WacomBusType bus, int vendor_id, int product_id);
 
+WacomDeviceDatabase *libwacom_database_alloc(GMappedFile *image);
+WacomDeviceDatabase *libwacom_database_new_for_paths(size_t npaths, const char **datadirs,
+						     WacomDatabaseFlags flags, bool use_cache);
+WacomDeviceDatabase *libwacom_database_new_embedded(const char *etcdir, WacomDatabaseFlags flags);
+void libwacom_database_add_device(WacomDeviceDatabase *db, const char *matchstr,
+				  const WacomMatch *match, WacomDevice *device);
+void libwacom_database_clear(WacomDeviceDatabase *db);
+struct udev_cache *libwacom_udev_cache_ref(struct udev_cache *cache);
+void libwacom_udev_cache_unref(struct udev_cache *cache);
+WacomDevice *libwacom_database_get_device(const WacomDeviceDatabase *db, const char *match);
+const WacomDevice *libwacom_database_lookup(const WacomDeviceDatabase *db, const char *name,
+					    WacomBusType bus, int vendor_id, int product_id);
+void libwacom_database_load_pending(const WacomDeviceDatabase *db);
+void libwacom_database_lock(const WacomDeviceDatabase *db);
+void libwacom_database_unlock(const WacomDeviceDatabase *db);
+bool libwacom_datadir_signature(const char *datadir, uint64_t *signature);
+
+bool libwacom_cache_write(const WacomDeviceDatabase *db, size_t ndirs, const char **datadirs,
+			  const char **install_dirs, const char *path, WacomError *error);
+bool libwacom_cache_load(WacomDeviceDatabase *db, const char *path,
+			 size_t ndirs, const char **datadirs);
+bool libwacom_cache_load_embedded_styli(WacomDeviceDatabase *db);
+bool libwacom_cache_load_embedded_devices(WacomDeviceDatabase *db);
+const char *libwacom_embedded_image(size_t *len);
+
+struct arena *libwacom_arena_new(void);
+struct arena *libwacom_arena_ref(struct arena *arena);
+struct arena *libwacom_arena_unref(struct arena *arena);
+void *libwacom_arena_alloc0(struct arena *arena, size_t size);
+void *libwacom_arena_memdup(struct arena *arena, const void *data, size_t size);
+char *libwacom_arena_intern(struct arena *arena, const char *str);
+char *libwacom_arena_take(struct arena *arena, char *str);
+
+bool libwacom_keyfile_load(struct keyfile *keyfile, const char *path, GError **error);
+void libwacom_keyfile_release(struct keyfile *keyfile);
+enum keyfile_key libwacom_keyfile_lookup_key(const char *key, size_t len);
+const struct keyfile_section *libwacom_keyfile_get_section(const struct keyfile *keyfile,
+							   const char *name);
+/* Strings and list items are unescaped in place, so each string or list
+ * value can only be fetched once */
+char *libwacom_keyfile_get_string(const struct keyfile_section *section, enum keyfile_key key);
+char *libwacom_keyfile_get_list(const struct keyfile_section *section, enum keyfile_key key);
+char *libwacom_keyfile_list_next(char **cursor);
+size_t libwacom_keyfile_list_max_length(const char *value);
+bool libwacom_keyfile_get_integer(const struct keyfile_section *section,
+				  enum keyfile_key key, int *value);
+bool libwacom_keyfile_get_boolean(const struct keyfile_section *section,
+				  enum keyfile_key key, bool *value);
+
+void libwacom_stats_init(WacomDeviceDatabase *db);
+void libwacom_stats_clear(WacomDeviceDatabase *db);
+uint64_t libwacom_stats_start(const WacomDeviceDatabase *db);
+void libwacom_stats_add(const WacomDeviceDatabase *db, WacomDatabaseStat stat, uint64_t value);
+void libwacom_stats_file_parsed(const WacomDeviceDatabase *db, const char *path, uint64_t start);
+
 #endif /* _LIBWACOMINT_H_ */
 
 /* vim: set noexpandtab shiftwidth=8: */
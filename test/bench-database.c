@@ -0,0 +1,161 @@
+/*
+ * Copyright © 2026 Red Hat, Inc.
+ *
+ * Permission to use, copy, modify, distribute, and sell this software
+ * and its documentation for any purpose is hereby granted without
+ * fee, provided that the above copyright notice appear in all copies
+ * and that both that copyright notice and this permission notice
+ * appear in supporting documentation, and that the name of Red Hat
+ * not be used in advertising or publicity pertaining to distribution
+ * of the software without specific, written prior permission.  Red
+ * Hat makes no representations about the suitability of this software
+ * for any purpose.  It is provided "as is" without express or implied
+ * warranty.
+ *
+ * THE AUTHORS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS SOFTWARE,
+ * INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS, IN
+ * NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS
+ * OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT,
+ * NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+#include "config.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "bench.h"
+
+#ifdef __GLIBC__
+#if __GLIBC_PREREQ(2, 33)
+#include <malloc.h>
+#define HAVE_MALLINFO2 1
+#endif
+#endif
+
+struct bench_database {
+	WacomDatabaseFlags flags;
+	const char *image;
+};
+
+/* Ask the kernel to drop the data files from the page cache. This only
+ * works for clean pages but doesn't need root. */
+static void
+drop_page_cache(void *data)
+{
+	const char *datadir = bench_datadir();
+	const char *file;
+	GDir *dir;
+
+	dir = g_dir_open(datadir, 0, NULL);
+	if (!dir)
+		return;
+
+	while ((file = g_dir_read_name(dir))) {
+		char *path = g_build_filename(datadir, file, NULL);
+		int fd = open(path, O_RDONLY);
+
+		if (fd >= 0) {
+			posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+			close(fd);
+		}
+		g_free(path);
+	}
+	g_dir_close(dir);
+}
+
+static void
+database_new(void *data)
+{
+	struct bench_database *b = data;
+	WacomDeviceDatabase *db;
+
+	db = libwacom_database_new_for_path_with_flags(bench_datadir(), b->flags);
+	if (!db)
+		abort();
+	libwacom_database_destroy(db);
+}
+
+static void
+database_new_from_image(void *data)
+{
+	struct bench_database *b = data;
+	WacomDeviceDatabase *db;
+
+	db = libwacom_database_new_from_image(b->image);
+	if (!db)
+		abort();
+	libwacom_database_destroy(db);
+}
+
+#ifdef HAVE_MALLINFO2
+static size_t
+heap_in_use(void)
+{
+	struct mallinfo2 info = mallinfo2();
+
+	return info.uordblks + info.hblkhd;
+}
+
+/* The heap memory a database keeps, i.e. what each process using it
+ * pays for, as opposed to the pages of a mapped image */
+static void
+bench_heap(const char *name, const struct bench_database *b)
+{
+	WacomDeviceDatabase *db;
+	size_t before;
+
+	before = heap_in_use();
+	if (b->image)
+		db = libwacom_database_new_from_image(b->image);
+	else
+		db = libwacom_database_new_for_path_with_flags(bench_datadir(), b->flags);
+	if (!db)
+		abort();
+	printf("%-40s %10zu bytes of heap\n", name, heap_in_use() - before);
+	libwacom_database_destroy(db);
+}
+#else
+static void
+bench_heap(const char *name, const struct bench_database *b)
+{
+}
+#endif
+
+/* argv[1] is an optional database image, see libwacom-update-cache */
+int main(int argc, char **argv)
+{
+	struct bench_database b = {0};
+
+	b.flags = WDATABASE_DEFAULT;
+	bench_heap("database_new/heap", &b);
+	bench_run("database_new/warm", NULL, database_new, &b);
+	bench_run("database_new/cold", drop_page_cache, database_new, &b);
+
+	b.flags = WDATABASE_LAZY;
+	bench_run("database_new/lazy/warm", NULL, database_new, &b);
+	bench_run("database_new/lazy/cold", drop_page_cache, database_new, &b);
+
+	b.flags = WDATABASE_PARALLEL;
+	bench_run("database_new/parallel/warm", NULL, database_new, &b);
+	bench_run("database_new/parallel/cold", drop_page_cache, database_new, &b);
+
+	if (argc > 1) {
+		struct stat st;
+
+		b.image = argv[1];
+		if (stat(b.image, &st) == 0)
+			printf("%-40s %10lld bytes mapped\n", "database_new_from_image/image",
+			       (long long)st.st_size);
+		bench_heap("database_new_from_image/heap", &b);
+		bench_run("database_new_from_image", NULL, database_new_from_image, &b);
+	}
+
+	return 0;
+}
+
+/* vim: set noexpandtab tabstop=8 shiftwidth=8: */
@@ -0,0 +1,130 @@
+/*
+ * Copyright © 2026 Red Hat, Inc.
+ *
+ * Permission to use, copy, modify, distribute, and sell this software
+ * and its documentation for any purpose is hereby granted without
+ * fee, provided that the above copyright notice appear in all copies
+ * and that both that copyright notice and this permission notice
+ * appear in supporting documentation, and that the name of Red Hat
+ * not be used in advertising or publicity pertaining to distribution
+ * of the software without specific, written prior permission.  Red
+ * Hat makes no representations about the suitability of this software
+ * for any purpose.  It is provided "as is" without express or implied
+ * warranty.
+ *
+ * THE AUTHORS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS SOFTWARE,
+ * INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS, IN
+ * NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS
+ * OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT,
+ * NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+#include "config.h"
+
+#include "bench.h"
+#include "libwacomint.h"
+
+struct bench_lookup {
+	WacomDeviceDatabase *db;
+	WacomDevice *a, *b;
+};
+
+static void
+lookup_usbid(void *data)
+{
+	struct bench_lookup *b = data;
+	WacomDevice *device;
+
+	device = libwacom_new_from_usbid(b->db, 0x56a, 0x00bc, NULL);
+	libwacom_destroy(device);
+}
+
+static void
+lookup_usbid_unknown(void *data)
+{
+	struct bench_lookup *b = data;
+
+	if (libwacom_new_from_usbid(b->db, 0x1234, 0x5678, NULL))
+		abort();
+}
+
+static void
+lookup_name(void *data)
+{
+	struct bench_lookup *b = data;
+	WacomDevice *device;
+
+	device = libwacom_new_from_name(b->db, "Wacom Intuos4 WL", NULL);
+	libwacom_destroy(device);
+}
+
+static void
+lookup_match(void *data)
+{
+	struct bench_lookup *b = data;
+
+	if (!libwacom_database_get_device(b->db, "usb:056a:00bc"))
+		abort();
+}
+
+static void
+compare(void *data)
+{
+	struct bench_lookup *b = data;
+
+	libwacom_compare(b->a, b->b, WCOMPARE_NORMAL);
+}
+
+static void
+compare_matches(void *data)
+{
+	struct bench_lookup *b = data;
+
+	libwacom_compare(b->a, b->b, WCOMPARE_MATCHES);
+}
+
+static void
+list_devices(void *data)
+{
+	struct bench_lookup *b = data;
+	WacomDevice **devices;
+
+	devices = libwacom_list_devices_from_database(b->db, NULL);
+	free(devices);
+}
+
+int main(int argc, char **argv)
+{
+	struct bench_lookup b;
+
+	b.db = libwacom_database_new_for_path(bench_datadir());
+	if (!b.db) {
+		fprintf(stderr, "Failed to load data from %s\n", bench_datadir());
+		return 1;
+	}
+
+	/* The lookups include creating the view on the database device
+	 * that is returned to the caller */
+	bench_run("new_from_usbid", NULL, lookup_usbid, &b);
+	bench_run("new_from_usbid/unknown", NULL, lookup_usbid_unknown, &b);
+	bench_run("new_from_name", NULL, lookup_name, &b);
+	bench_run("database_get_device", NULL, lookup_match, &b);
+
+	b.a = libwacom_new_from_usbid(b.db, 0x56a, 0x00bc, NULL);
+	b.b = libwacom_new_from_usbid(b.db, 0x56a, 0x00b8, NULL);
+	bench_run("compare", NULL, compare, &b);
+	bench_run("compare/matches", NULL, compare_matches, &b);
+	libwacom_destroy(b.a);
+	libwacom_destroy(b.b);
+
+	bench_run("list_devices_from_database", NULL, list_devices, &b);
+
+	libwacom_database_destroy(b.db);
+
+	return 0;
+}
+
+/* vim: set noexpandtab tabstop=8 shiftwidth=8: */
@@ -0,0 +1,137 @@
+/*
+ * Copyright © 2026 Red Hat, Inc.
+ *
+ * Permission to use, copy, modify, distribute, and sell this software
+ * and its documentation for any purpose is hereby granted without
+ * fee, provided that the above copyright notice appear in all copies
+ * and that both that copyright notice and this permission notice
+ * appear in supporting documentation, and that the name of Red Hat
+ * not be used in advertising or publicity pertaining to distribution
+ * of the software without specific, written prior permission.  Red
+ * Hat makes no representations about the suitability of this software
+ * for any purpose.  It is provided "as is" without express or implied
+ * warranty.
+ *
+ * THE AUTHORS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS SOFTWARE,
+ * INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS, IN
+ * NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS
+ * OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT,
+ * NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/* Shared helpers for the benchmarks, run with meson test --benchmark. Each
+ * benchmark is a single source file that includes this header once. */
+
+#ifndef _BENCH_H_
+#define _BENCH_H_
+
+#include <glib.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "libwacom.h"
+
+/* Minimum wall time spent in each benchmark, in ns */
+#define BENCH_MIN_TIME (200 * 1000 * 1000ULL)
+
+static uint64_t bench_nallocs;
+
+#ifdef __GLIBC__
+/* Count allocations by interposing the allocator, this covers
+ * libwacom and glib since both allocate through malloc() */
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+void *malloc(size_t size);
+void *calloc(size_t nmemb, size_t size);
+void *realloc(void *ptr, size_t size);
+
+void *
+malloc(size_t size)
+{
+	__atomic_add_fetch(&bench_nallocs, 1, __ATOMIC_RELAXED);
+	return __libc_malloc(size);
+}
+
+void *
+calloc(size_t nmemb, size_t size)
+{
+	__atomic_add_fetch(&bench_nallocs, 1, __ATOMIC_RELAXED);
+	return __libc_calloc(nmemb, size);
+}
+
+void *
+realloc(void *ptr, size_t size)
+{
+	__atomic_add_fetch(&bench_nallocs, 1, __ATOMIC_RELAXED);
+	return __libc_realloc(ptr, size);
+}
+#define BENCH_HAVE_ALLOC_COUNT 1
+#else
+#define BENCH_HAVE_ALLOC_COUNT 0
+#endif
+
+typedef void (*bench_func_t)(void *data);
+
+static inline uint64_t
+bench_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static inline const char *
+bench_datadir(void)
+{
+	const char *datadir = getenv("LIBWACOM_DATA_DIR");
+
+	return datadir ? datadir : TOPSRCDIR"/data";
+}
+
+/**
+ * Run func until at least BENCH_MIN_TIME has passed and print the time
+ * and number of allocations per call. If setup is not NULL, it is called
+ * before each call to func and its time is not counted.
+ */
+static inline void
+bench_run(const char *name, bench_func_t setup, bench_func_t func, void *data)
+{
+	uint64_t elapsed = 0, nallocs = 0, iterations = 0;
+
+	/* Warm up, this also loads anything lazily initialized */
+	if (setup)
+		setup(data);
+	func(data);
+
+	while (elapsed < BENCH_MIN_TIME) {
+		uint64_t start, allocs_before;
+
+		if (setup)
+			setup(data);
+
+		allocs_before = __atomic_load_n(&bench_nallocs, __ATOMIC_RELAXED);
+		start = bench_now();
+		func(data);
+		elapsed += bench_now() - start;
+		nallocs += __atomic_load_n(&bench_nallocs, __ATOMIC_RELAXED) - allocs_before;
+		iterations++;
+	}
+
+	if (BENCH_HAVE_ALLOC_COUNT)
+		printf("%-40s %10" PRIu64 " ns/op %10.1f allocs/op (%" PRIu64 " runs)\n",
+		       name, elapsed / iterations, (double)nallocs / iterations, iterations);
+	else
+		printf("%-40s %10" PRIu64 " ns/op (%" PRIu64 " runs)\n",
+		       name, elapsed / iterations, iterations);
+}
+
+#endif /* _BENCH_H_ */
+
+/* vim: set noexpandtab tabstop=8 shiftwidth=8: */
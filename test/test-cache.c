@@ -0,0 +1,310 @@
+/*
+ * Copyright © 2026 Red Hat, Inc.
+ *
+ * Permission to use, copy, modify, distribute, and sell this software
+ * and its documentation for any purpose is hereby granted without
+ * fee, provided that the above copyright notice appear in all copies
+ * and that both that copyright notice and this permission notice
+ * appear in supporting documentation, and that the name of Red Hat
+ * not be used in advertising or publicity pertaining to distribution
+ * of the software without specific, written prior permission.  Red
+ * Hat makes no representations about the suitability of this software
+ * for any purpose.  It is provided "as is" without express or implied
+ * warranty.
+ *
+ * THE AUTHORS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS SOFTWARE,
+ * INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS, IN
+ * NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS
+ * OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT,
+ * NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <glib.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "libwacomint.h"
+
+struct fixture {
+	char *tmpdir;
+	char *cache;
+	const char *datadirs[2];
+	WacomDeviceDatabase *db;
+};
+
+static void
+fixture_setup(struct fixture *f, gconstpointer user_data)
+{
+	f->tmpdir = g_dir_make_tmp("tmp.cache.XXXXXX", NULL);
+	g_assert_nonnull(f->tmpdir);
+	f->cache = g_build_filename(f->tmpdir, CACHE_FILENAME, NULL);
+
+	/* The tmpdir takes the role of ETCDIR, it has no data files */
+	f->datadirs[0] = f->tmpdir;
+	f->datadirs[1] = TOPSRCDIR"/data";
+
+	f->db = libwacom_database_new_for_paths(2, f->datadirs, WDATABASE_DEFAULT, false);
+	g_assert_nonnull(f->db);
+	g_assert_true(libwacom_cache_write(f->db, 2, f->datadirs, NULL, f->cache, NULL));
+}
+
+static void
+fixture_teardown(struct fixture *f, gconstpointer user_data)
+{
+	char *stylus = g_build_filename(f->tmpdir, "extra.stylus", NULL);
+
+	unlink(stylus);
+	unlink(f->cache);
+	g_assert_cmpint(rmdir(f->tmpdir), ==, 0);
+
+	g_free(stylus);
+	g_free(f->cache);
+	g_free(f->tmpdir);
+	libwacom_database_destroy(f->db);
+}
+
+static void
+compare_styli(const WacomStylus *a, const WacomStylus *b)
+{
+	int na, nb;
+	const int *ia, *ib;
+
+	g_assert_nonnull(b);
+	g_assert_cmpstr(a->name, ==, b->name);
+	g_assert_cmpstr(a->group, ==, b->group);
+	g_assert_cmpint(a->num_buttons, ==, b->num_buttons);
+	g_assert_cmpint(a->has_eraser, ==, b->has_eraser);
+	g_assert_cmpint(a->has_lens, ==, b->has_lens);
+	g_assert_cmpint(a->has_wheel, ==, b->has_wheel);
+	g_assert_cmpint(a->eraser_type, ==, b->eraser_type);
+	g_assert_cmpint(a->type, ==, b->type);
+	g_assert_cmpint(a->axes, ==, b->axes);
+
+	ia = libwacom_stylus_get_paired_ids(a, &na);
+	ib = libwacom_stylus_get_paired_ids(b, &nb);
+	g_assert_cmpint(na, ==, nb);
+	for (int i = 0; i < na; i++)
+		g_assert_cmpint(ia[i], ==, ib[i]);
+}
+
+static void
+test_cache_roundtrip(struct fixture *f, gconstpointer user_data)
+{
+	WacomDeviceDatabase *cached;
+	WacomDevice **devices, **cached_devices;
+	GHashTableIter iter;
+	gpointer key, value;
+
+	cached = libwacom_database_alloc(NULL);
+	g_assert_true(libwacom_cache_load(cached, f->cache, 2, f->datadirs));
+
+	g_assert_cmpint(g_hash_table_size(cached->device_ht), ==,
+			g_hash_table_size(f->db->device_ht));
+	g_assert_cmpint(g_hash_table_size(cached->stylus_ht), ==,
+			g_hash_table_size(f->db->stylus_ht));
+
+	g_hash_table_iter_init(&iter, f->db->device_ht);
+	while (g_hash_table_iter_next(&iter, &key, &value)) {
+		const WacomDevice *a = value;
+		const WacomDevice *b = g_hash_table_lookup(cached->device_ht, key);
+
+		g_assert_nonnull(b);
+		g_assert_cmpint(libwacom_compare(a, b, WCOMPARE_MATCHES), ==, 0);
+		g_assert_cmpstr(libwacom_get_model_name(a), ==, libwacom_get_model_name(b));
+		g_assert_cmpstr(libwacom_get_layout_filename(a), ==, libwacom_get_layout_filename(b));
+		g_assert_cmpint(libwacom_get_num_keys(a), ==, libwacom_get_num_keys(b));
+	}
+
+	g_hash_table_iter_init(&iter, f->db->stylus_ht);
+	while (g_hash_table_iter_next(&iter, &key, &value))
+		compare_styli(value, g_hash_table_lookup(cached->stylus_ht, key));
+
+	/* Sorted device lists must be identical too */
+	devices = libwacom_list_devices_from_database(f->db, NULL);
+	cached_devices = libwacom_list_devices_from_database(cached, NULL);
+	for (int i = 0; devices[i] || cached_devices[i]; i++)
+		g_assert_cmpint(libwacom_compare(devices[i], cached_devices[i], WCOMPARE_MATCHES), ==, 0);
+	free(devices);
+	free(cached_devices);
+
+	libwacom_database_destroy(cached);
+}
+
+static void
+test_cache_used(struct fixture *f, gconstpointer user_data)
+{
+	WacomDeviceDatabase *db;
+	WacomDevice *device;
+
+	/* The cache sits in the first data directory and matches */
+	db = libwacom_database_new_for_paths(2, f->datadirs, WDATABASE_DEFAULT, true);
+	g_assert_nonnull(db);
+
+	device = libwacom_new_from_usbid(db, 0x56a, 0x00bc, NULL);
+	g_assert_nonnull(device);
+	g_assert_cmpstr(libwacom_get_name(device), ==, "Wacom Intuos4 WL");
+	libwacom_destroy(device);
+
+	libwacom_database_destroy(db);
+}
+
+static void
+test_cache_stale(struct fixture *f, gconstpointer user_data)
+{
+	WacomDeviceDatabase *db;
+	char *stylus;
+
+	/* Different set of directories */
+	db = libwacom_database_alloc(NULL);
+	g_assert_false(libwacom_cache_load(db, f->cache, 1, &f->datadirs[1]));
+	libwacom_database_destroy(db);
+
+	/* A new data file in one of the directories */
+	stylus = g_build_filename(f->tmpdir, "extra.stylus", NULL);
+	g_assert_true(g_file_set_contents(stylus, "[0x12345]\nName=Extra Pen\n", -1, NULL));
+	g_free(stylus);
+
+	db = libwacom_database_alloc(NULL);
+	g_assert_false(libwacom_cache_load(db, f->cache, 2, f->datadirs));
+	g_assert_cmpint(g_hash_table_size(db->device_ht), ==, 0);
+	libwacom_database_destroy(db);
+
+	/* Falls back to parsing the data files */
+	db = libwacom_database_new_for_paths(2, f->datadirs, WDATABASE_DEFAULT, true);
+	g_assert_nonnull(db);
+	g_assert_nonnull(libwacom_stylus_get_for_id(db, 0x12345));
+	libwacom_database_destroy(db);
+}
+
+static void
+test_cache_invalid(struct fixture *f, gconstpointer user_data)
+{
+	WacomDeviceDatabase *db;
+	char *contents;
+	gsize len;
+
+	g_assert_true(g_file_get_contents(f->cache, &contents, &len, NULL));
+	g_assert_true(g_file_set_contents(f->cache, contents, len / 2, NULL));
+	g_free(contents);
+
+	g_test_expect_message(G_LOG_DOMAIN, G_LOG_LEVEL_WARNING, "Ignoring invalid database cache*");
+	db = libwacom_database_alloc(NULL);
+	g_assert_false(libwacom_cache_load(db, f->cache, 2, f->datadirs));
+	g_test_assert_expected_messages();
+	libwacom_database_destroy(db);
+}
+
+/* Offsets in struct cache_header and struct cache_match */
+#define HEADER_NMATCHES 40
+#define HEADER_MATCHES 44
+#define MATCH_SIZE 20
+#define MATCH_BUS 8
+#define MATCH_VENDOR_ID 12
+
+static void
+test_cache_invalid_bus(struct fixture *f, gconstpointer user_data)
+{
+	const uint32_t buses[] = { WBUSTYPE_UNKNOWN, WBUSTYPE_I2C + 1, 0xffffffff };
+	char *contents;
+	gsize len;
+	uint32_t nmatches, matches, offset = 0;
+
+	g_assert_true(g_file_get_contents(f->cache, &contents, &len, NULL));
+	memcpy(&nmatches, contents + HEADER_NMATCHES, sizeof(nmatches));
+	memcpy(&matches, contents + HEADER_MATCHES, sizeof(matches));
+
+	/* Any match with IDs, the generic match has none */
+	for (uint32_t i = 0; i < nmatches && !offset; i++) {
+		uint32_t vendor_id;
+
+		memcpy(&vendor_id, contents + matches + i * MATCH_SIZE + MATCH_VENDOR_ID,
+		       sizeof(vendor_id));
+		if (vendor_id != 0)
+			offset = matches + i * MATCH_SIZE + MATCH_BUS;
+	}
+	g_assert_cmpint(offset, !=, 0);
+
+	for (size_t i = 0; i < G_N_ELEMENTS(buses); i++) {
+		WacomDeviceDatabase *db;
+
+		memcpy(contents + offset, &buses[i], sizeof(buses[i]));
+		g_assert_true(g_file_set_contents(f->cache, contents, len, NULL));
+
+		g_test_expect_message(G_LOG_DOMAIN, G_LOG_LEVEL_WARNING, "Ignoring invalid database cache*");
+		db = libwacom_database_alloc(NULL);
+		g_assert_false(libwacom_cache_load(db, f->cache, 2, f->datadirs));
+		g_test_assert_expected_messages();
+		libwacom_database_destroy(db);
+
+		g_test_expect_message(G_LOG_DOMAIN, G_LOG_LEVEL_WARNING, "Invalid database image*");
+		g_assert_null(libwacom_database_new_from_image(f->cache));
+		g_test_assert_expected_messages();
+	}
+
+	g_free(contents);
+}
+
+static void
+test_cache_image(struct fixture *f, gconstpointer user_data)
+{
+	WacomDeviceDatabase *db;
+	WacomDevice *device, *expected;
+	const WacomStylus *stylus;
+
+	db = libwacom_database_new_from_image(f->cache);
+	g_assert_nonnull(db);
+
+	device = libwacom_new_from_usbid(db, 0x56a, 0x00bc, NULL);
+	expected = libwacom_new_from_usbid(f->db, 0x56a, 0x00bc, NULL);
+	g_assert_nonnull(device);
+	g_assert_cmpint(libwacom_compare(device, expected, WCOMPARE_MATCHES), ==, 0);
+	g_assert_cmpstr(libwacom_get_layout_filename(device), ==,
+			libwacom_get_layout_filename(expected));
+
+	stylus = libwacom_stylus_get_for_id(db, 0x802);
+	g_assert_nonnull(stylus);
+	g_assert_true(stylus->image != NULL);
+	g_assert_cmpstr(libwacom_stylus_get_name(stylus), ==, "Grip Pen");
+
+	/* Devices keep the image alive */
+	libwacom_database_destroy(db);
+	g_assert_cmpstr(libwacom_get_match(device), ==, libwacom_get_match(expected));
+
+	libwacom_destroy(device);
+	libwacom_destroy(expected);
+}
+
+int main(int argc, char **argv)
+{
+	g_test_init(&argc, &argv, NULL);
+	g_test_set_nonfatal_assertions();
+
+	g_test_add("/cache/roundtrip", struct fixture, NULL,
+		   fixture_setup, test_cache_roundtrip,
+		   fixture_teardown);
+	g_test_add("/cache/used", struct fixture, NULL,
+		   fixture_setup, test_cache_used,
+		   fixture_teardown);
+	g_test_add("/cache/stale", struct fixture, NULL,
+		   fixture_setup, test_cache_stale,
+		   fixture_teardown);
+	g_test_add("/cache/image", struct fixture, NULL,
+		   fixture_setup, test_cache_image,
+		   fixture_teardown);
+	g_test_add("/cache/invalid", struct fixture, NULL,
+		   fixture_setup, test_cache_invalid,
+		   fixture_teardown);
+	g_test_add("/cache/invalid/bus", struct fixture, NULL,
+		   fixture_setup, test_cache_invalid_bus,
+		   fixture_teardown);
+
+	return g_test_run();
+}
+
+/* vim: set noexpandtab tabstop=8 shiftwidth=8: */
@@ -0,0 +1,154 @@
+/*
+ * Copyright © 2026 Red Hat, Inc.
+ *
+ * Permission to use, copy, modify, distribute, and sell this software
+ * and its documentation for any purpose is hereby granted without
+ * fee, provided that the above copyright notice appear in all copies
+ * and that both that copyright notice and this permission notice
+ * appear in supporting documentation, and that the name of Red Hat
+ * not be used in advertising or publicity pertaining to distribution
+ * of the software without specific, written prior permission.  Red
+ * Hat makes no representations about the suitability of this software
+ * for any purpose.  It is provided "as is" without express or implied
+ * warranty.
+ *
+ * THE AUTHORS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS SOFTWARE,
+ * INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS, IN
+ * NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS
+ * OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT,
+ * NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <glib.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "libwacomint.h"
+
+/* This test is linked with a generated libwacom-embedded.c, the same one
+ * the embedded-database option compiles into the library */
+
+struct fixture {
+	char *tmpdir;
+	char *override;
+	const char *datadirs[2];
+	WacomDeviceDatabase *db;
+};
+
+static void
+fixture_setup(struct fixture *f, gconstpointer user_data)
+{
+	f->tmpdir = g_dir_make_tmp("tmp.embedded.XXXXXX", NULL);
+	g_assert_nonnull(f->tmpdir);
+	f->override = g_build_filename(f->tmpdir, "override.tablet", NULL);
+
+	/* The tmpdir takes the role of ETCDIR. The embedded database is
+	 * generated from the git tree's data files, so a database loaded
+	 * from those files must be identical. */
+	f->datadirs[0] = f->tmpdir;
+	f->datadirs[1] = TOPSRCDIR"/data";
+}
+
+static void
+fixture_teardown(struct fixture *f, gconstpointer user_data)
+{
+	unlink(f->override);
+	g_assert_cmpint(rmdir(f->tmpdir), ==, 0);
+
+	g_free(f->override);
+	g_free(f->tmpdir);
+	if (f->db)
+		libwacom_database_destroy(f->db);
+}
+
+static void
+compare_databases(WacomDeviceDatabase *db, WacomDeviceDatabase *expected)
+{
+	GHashTableIter iter;
+	gpointer key, value;
+
+	g_assert_cmpuint(libwacom_database_get_stat(db, WSTAT_NUM_MATCHES), ==,
+			 libwacom_database_get_stat(expected, WSTAT_NUM_MATCHES));
+	g_assert_cmpuint(libwacom_database_get_stat(db, WSTAT_NUM_STYLI), ==,
+			 libwacom_database_get_stat(expected, WSTAT_NUM_STYLI));
+
+	g_hash_table_iter_init(&iter, expected->device_ht);
+	while (g_hash_table_iter_next(&iter, &key, &value)) {
+		WacomDevice *device = libwacom_database_get_device(db, key);
+
+		g_assert_nonnull(device);
+		g_assert_cmpstr(libwacom_get_name(device), ==, libwacom_get_name(value));
+		g_assert_cmpint(libwacom_get_num_buttons(device), ==,
+				libwacom_get_num_buttons(value));
+	}
+}
+
+static void
+test_embedded_image(struct fixture *f, gconstpointer user_data)
+{
+	WacomDeviceDatabase *expected;
+	size_t len;
+
+	g_assert_nonnull(libwacom_embedded_image(&len));
+	g_assert_cmpuint(len, >, 0);
+
+	f->db = libwacom_database_new_embedded(f->tmpdir, WDATABASE_DEFAULT);
+	g_assert_nonnull(f->db);
+
+	expected = libwacom_database_new_for_paths(2, f->datadirs, WDATABASE_DEFAULT, false);
+	g_assert_nonnull(expected);
+	compare_databases(f->db, expected);
+	libwacom_database_destroy(expected);
+}
+
+static void
+test_embedded_override(struct fixture *f, gconstpointer user_data)
+{
+	const char *override =
+		"[Device]\n"
+		"Name=Embedded Override\n"
+		"DeviceMatch=usb:056a:00bc;usb:1234:5678\n";
+	WacomDeviceDatabase *expected;
+	WacomDevice *device;
+
+	g_assert_true(g_file_set_contents(f->override, override, -1, NULL));
+
+	f->db = libwacom_database_new_embedded(f->tmpdir, WDATABASE_DEFAULT);
+	g_assert_nonnull(f->db);
+
+	/* The override replaces a device from the image and adds one */
+	device = libwacom_database_get_device(f->db, "usb:056a:00bc");
+	g_assert_nonnull(device);
+	g_assert_cmpstr(libwacom_get_name(device), ==, "Embedded Override");
+	g_assert_true(device == libwacom_database_get_device(f->db, "usb:1234:5678"));
+	device = libwacom_database_get_device(f->db, "usb:056a:00b8");
+	g_assert_nonnull(device);
+	g_assert_cmpstr(libwacom_get_name(device), ==, "Wacom Intuos4 4x6");
+
+	expected = libwacom_database_new_for_paths(2, f->datadirs, WDATABASE_DEFAULT, false);
+	g_assert_nonnull(expected);
+	compare_databases(f->db, expected);
+	libwacom_database_destroy(expected);
+}
+
+int main(int argc, char **argv)
+{
+	g_test_init(&argc, &argv, NULL);
+	g_test_set_nonfatal_assertions();
+
+	g_test_add("/embedded/image", struct fixture, NULL,
+		   fixture_setup, test_embedded_image,
+		   fixture_teardown);
+	g_test_add("/embedded/override", struct fixture, NULL,
+		   fixture_setup, test_embedded_override,
+		   fixture_teardown);
+
+	return g_test_run();
+}
+
+/* vim: set noexpandtab tabstop=8 shiftwidth=8: */
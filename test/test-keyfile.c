@@ -0,0 +1,427 @@
+/*
+ * Copyright © 2026 Red Hat, Inc.
+ *
+ * Permission to use, copy, modify, distribute, and sell this software
+ * and its documentation for any purpose is hereby granted without
+ * fee, provided that the above copyright notice appear in all copies
+ * and that both that copyright notice and this permission notice
+ * appear in supporting documentation, and that the name of Red Hat
+ * not be used in advertising or publicity pertaining to distribution
+ * of the software without specific, written prior permission.  Red
+ * Hat makes no representations about the suitability of this software
+ * for any purpose.  It is provided "as is" without express or implied
+ * warranty.
+ *
+ * THE AUTHORS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS SOFTWARE,
+ * INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS, IN
+ * NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS
+ * OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT,
+ * NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <dirent.h>
+#include <glib.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "libwacomint.h"
+
+/* In enum keyfile_key order */
+static const char *keys[] = {
+	"DeviceMatch", "PairedID", "Name", "ModelName", "Width", "Height",
+	"IntegratedIn", "Layout", "Class", "Styli",
+	"Stylus", "Touch", "Ring", "Ring2", "Reversible", "TouchSwitch",
+	"NumStrips", "StatusLEDs",
+	"Left", "Right", "Top", "Bottom", "Touchstrip", "Touchstrip2", "OLEDs",
+	"EvdevCodes", "RingNumModes", "Ring2NumModes", "StripsNumModes",
+	"KeyCodes",
+	"Group", "EraserType", "PairedStylusIds", "HasLens", "HasWheel",
+	"Buttons", "Axes", "Type",
+};
+
+static void
+test_keyfile_lookup(void)
+{
+	g_assert_cmpint(G_N_ELEMENTS(keys), ==, KF_NUM_KEYS);
+
+	for (int i = 0; i < KF_NUM_KEYS; i++)
+		g_assert_cmpint(libwacom_keyfile_lookup_key(keys[i], strlen(keys[i])), ==, i);
+
+	g_assert_cmpint(libwacom_keyfile_lookup_key("Nam", 3), ==, KF_UNKNOWN);
+	g_assert_cmpint(libwacom_keyfile_lookup_key("Names", 5), ==, KF_UNKNOWN);
+	g_assert_cmpint(libwacom_keyfile_lookup_key("Name[de]", 8), ==, KF_UNKNOWN);
+	g_assert_cmpint(libwacom_keyfile_lookup_key("", 0), ==, KF_UNKNOWN);
+}
+
+/* Everything we parse must match what GKeyFile makes of the file */
+static void
+compare_with_gkeyfile(const char *path)
+{
+	struct keyfile keyfile;
+	GKeyFile *expected;
+	char **groups;
+	gsize ngroups;
+
+	expected = g_key_file_new();
+	g_assert_true(g_key_file_load_from_file(expected, path, G_KEY_FILE_NONE, NULL));
+	g_assert_true(libwacom_keyfile_load(&keyfile, path, NULL));
+
+	groups = g_key_file_get_groups(expected, &ngroups);
+	g_assert_cmpuint(keyfile.sections->len, ==, ngroups);
+
+	for (gsize i = 0; i < ngroups; i++) {
+		const struct keyfile_section *section;
+
+		section = &g_array_index(keyfile.sections, struct keyfile_section, i);
+		g_assert_cmpstr(section->name, ==, groups[i]);
+		g_assert_true(libwacom_keyfile_get_section(&keyfile, groups[i]) == section);
+
+		for (int key = 0; key < KF_NUM_KEYS; key++) {
+			char *value = g_key_file_get_value(expected, groups[i], keys[key], NULL);
+			char **list, *copy, *cursor;
+			int ival;
+			bool bval;
+			GError *error = NULL;
+
+			g_assert_cmpstr(section->values[key], ==, value);
+			g_free(value);
+			if (!section->values[key])
+				continue;
+
+			ival = g_key_file_get_integer(expected, groups[i], keys[key], &error);
+			g_assert_cmpint(libwacom_keyfile_get_integer(section, key, &ival), ==, error == NULL);
+			if (!error)
+				g_assert_cmpint(ival, ==, g_key_file_get_integer(expected, groups[i], keys[key], NULL));
+			g_clear_error(&error);
+
+			bval = g_key_file_get_boolean(expected, groups[i], keys[key], &error);
+			g_assert_cmpint(libwacom_keyfile_get_boolean(section, key, &bval), ==, error == NULL);
+			if (!error)
+				g_assert_cmpint(bval, ==, g_key_file_get_boolean(expected, groups[i], keys[key], NULL));
+			g_clear_error(&error);
+
+			/* Lists are unescaped in place, so use a copy */
+			list = g_key_file_get_string_list(expected, groups[i], keys[key], NULL, NULL);
+			copy = g_strdup(libwacom_keyfile_get_list(section, key));
+			g_assert_true((copy == NULL) == (list == NULL));
+			cursor = copy;
+			for (char **item = list; item && *item; item++)
+				g_assert_cmpstr(libwacom_keyfile_list_next(&cursor), ==, *item);
+			g_assert_null(libwacom_keyfile_list_next(&cursor));
+			g_assert_cmpuint(libwacom_keyfile_list_max_length(section->values[key]), >=,
+					 list ? g_strv_length(list) : 0);
+			g_strfreev(list);
+			g_free(copy);
+
+			value = g_key_file_get_string(expected, groups[i], keys[key], NULL);
+			g_assert_cmpstr(libwacom_keyfile_get_string(section, key), ==, value);
+			g_free(value);
+		}
+	}
+
+	g_strfreev(groups);
+	g_key_file_free(expected);
+	libwacom_keyfile_release(&keyfile);
+}
+
+static void
+test_keyfile_data_files(void)
+{
+	const char *datadir = TOPSRCDIR"/data";
+	DIR *dir;
+	struct dirent *file;
+	int nfiles = 0;
+
+	dir = opendir(datadir);
+	g_assert_nonnull(dir);
+
+	while ((file = readdir(dir))) {
+		char *path;
+
+		if (!g_str_has_suffix(file->d_name, ".tablet") &&
+		    !g_str_has_suffix(file->d_name, ".stylus"))
+			continue;
+
+		path = g_build_filename(datadir, file->d_name, NULL);
+		compare_with_gkeyfile(path);
+		g_free(path);
+		nfiles++;
+	}
+	closedir(dir);
+
+	g_assert_cmpint(nfiles, >, 0);
+}
+
+static char *
+write_tmpfile(const char *contents)
+{
+	char *path;
+	int fd;
+
+	fd = g_file_open_tmp("tmp.keyfile.XXXXXX", &path, NULL);
+	g_assert_cmpint(fd, >=, 0);
+	g_assert_true(g_file_set_contents(path, contents, -1, NULL));
+	close(fd);
+
+	return path;
+}
+
+static void
+test_keyfile_syntax(void)
+{
+	const char *contents =
+		"# comment\n"
+		"\n"
+		"  [Device]  \n"
+		"Name = Some \\sTablet\\t \n"
+		"DeviceMatch=usb:056a:0001;usb:056a:0002;\r\n"
+		"Styli=0x1;;@group\\;x;\n"
+		"Layout=\n"
+		"Unknown=value\n"
+		"Width=  12 \n"
+		"Height=12cm\n"
+		"\t# indented comment\n"
+		"[Features]\n"
+		"Touch=true \n"
+		"Ring=1\n"
+		"Ring2=yes\n"
+		"[Device]\n"
+		"Name=Overridden\n"
+		"Class=Bamboo\n";
+	char *path = write_tmpfile(contents);
+	struct keyfile keyfile;
+	const struct keyfile_section *section;
+
+	compare_with_gkeyfile(path);
+
+	g_assert_true(libwacom_keyfile_load(&keyfile, path, NULL));
+	g_assert_cmpuint(keyfile.sections->len, ==, 2);
+	section = libwacom_keyfile_get_section(&keyfile, "Device");
+	g_assert_nonnull(section);
+	g_assert_cmpstr(libwacom_keyfile_get_string(section, KF_NAME), ==, "Overridden");
+	g_assert_cmpstr(libwacom_keyfile_get_string(section, KF_CLASS), ==, "Bamboo");
+	g_assert_null(libwacom_keyfile_get_section(&keyfile, "Buttons"));
+	libwacom_keyfile_release(&keyfile);
+
+	unlink(path);
+	g_free(path);
+}
+
+static void
+test_keyfile_invalid(void)
+{
+	const char *invalid[] = {
+		"Name=no group\n",
+		"[Device]\nNot a key value pair\n",
+	};
+
+	for (size_t i = 0; i < G_N_ELEMENTS(invalid); i++) {
+		char *path = write_tmpfile(invalid[i]);
+		struct keyfile keyfile;
+		GError *error = NULL;
+
+		g_assert_false(libwacom_keyfile_load(&keyfile, path, &error));
+		g_assert_error(error, G_KEY_FILE_ERROR, i == 0 ?
+			       G_KEY_FILE_ERROR_GROUP_NOT_FOUND :
+			       G_KEY_FILE_ERROR_PARSE);
+		g_clear_error(&error);
+		libwacom_keyfile_release(&keyfile);
+
+		unlink(path);
+		g_free(path);
+	}
+}
+
+static char *
+write_datafile(const char *dir, const char *filename, const char *contents)
+{
+	char *path = g_build_filename(dir, filename, NULL);
+
+	g_assert_true(g_file_set_contents(path, contents, -1, NULL));
+
+	return path;
+}
+
+/* A lazy database must end up with the same devices as a fully loaded one,
+ * including for ETCDIR files that fail to parse */
+static void
+test_keyfile_lazy_override(void)
+{
+	const char *broken =
+		"[Device]\n"
+		"DeviceMatch=usb:056a:00bc\n"
+		"Not a key value pair\n";
+	const char *override =
+		"[Device]\n"
+		"Name=Lazy Override\n"
+		"# DeviceMatch=usb:056a:00ba\n"
+		"DeviceMatch=usb:056a:00b8\n"
+		"DeviceMatch=usb:056a:00b9;usb:1234:5678:Lazy\\sPen;\n";
+	const char *matches[] = {
+		"usb:056a:00bc", "usb:056a:00ba", "usb:056a:00b8",
+		"usb:056a:00b9", "usb:1234:5678:Lazy Pen",
+	};
+	const char *datadirs[2];
+	char *tmpdir, *broken_path, *override_path;
+	WacomDeviceDatabase *eager, *lazy;
+
+	tmpdir = g_dir_make_tmp("tmp.keyfile.XXXXXX", NULL);
+	g_assert_nonnull(tmpdir);
+	broken_path = write_datafile(tmpdir, "broken.tablet", broken);
+	override_path = write_datafile(tmpdir, "override.tablet", override);
+
+	/* The tmpdir takes the role of ETCDIR */
+	datadirs[0] = tmpdir;
+	datadirs[1] = TOPSRCDIR"/data";
+	eager = libwacom_database_new_for_paths(2, datadirs, WDATABASE_DEFAULT, false);
+	lazy = libwacom_database_new_for_paths(2, datadirs, WDATABASE_LAZY, false);
+	g_assert_nonnull(eager);
+	g_assert_nonnull(lazy);
+
+	for (size_t i = 0; i < G_N_ELEMENTS(matches); i++) {
+		WacomDevice *e = libwacom_database_get_device(eager, matches[i]);
+		WacomDevice *l = libwacom_database_get_device(lazy, matches[i]);
+
+		g_assert_true((e == NULL) == (l == NULL));
+		if (e)
+			g_assert_cmpstr(libwacom_get_name(e), ==, libwacom_get_name(l));
+	}
+
+	g_assert_cmpstr(libwacom_get_name(libwacom_database_get_device(lazy, "usb:056a:00bc")),
+			==, "Wacom Intuos4 WL");
+	g_assert_cmpstr(libwacom_get_name(libwacom_database_get_device(lazy, "usb:056a:00b8")),
+			==, "Wacom Intuos4 4x6");
+	g_assert_cmpstr(libwacom_get_name(libwacom_database_get_device(lazy, "usb:056a:00b9")),
+			==, "Lazy Override");
+	g_assert_nonnull(libwacom_database_get_device(lazy, "usb:1234:5678:Lazy Pen"));
+
+	libwacom_database_load_pending(lazy);
+	g_assert_cmpuint(libwacom_database_get_stat(lazy, WSTAT_NUM_MATCHES), ==,
+			 libwacom_database_get_stat(eager, WSTAT_NUM_MATCHES));
+
+	libwacom_database_destroy(eager);
+	libwacom_database_destroy(lazy);
+	unlink(broken_path);
+	unlink(override_path);
+	g_assert_cmpint(rmdir(tmpdir), ==, 0);
+	g_free(broken_path);
+	g_free(override_path);
+	g_free(tmpdir);
+}
+
+static void
+check_watched_name(WacomDeviceDatabase *db, int product_id, const char *name)
+{
+	WacomDevice *device = libwacom_new_from_usbid(db, 0x1234, product_id, NULL);
+
+	g_assert_nonnull(device);
+	g_assert_cmpstr(libwacom_get_name(device), ==, name);
+	libwacom_destroy(device);
+}
+
+/* A watched database where the file that loses a match was reloaded
+ * before a file in an earlier directory takes the match over. Each
+ * reload has its own arena, device_ht must not keep the loser's key. */
+static void
+test_keyfile_watch_override(void)
+{
+	const char *dirs[2];
+	char *etcdir, *datadir, *stylus, *loser, *other, *winner, *duplicate, *contents;
+	WacomDeviceDatabase *db, *snapshot;
+	gsize len;
+
+	etcdir = g_dir_make_tmp("tmp.keyfile.XXXXXX", NULL);
+	datadir = g_dir_make_tmp("tmp.keyfile.XXXXXX", NULL);
+	g_assert_nonnull(etcdir);
+	g_assert_nonnull(datadir);
+
+	g_assert_true(g_file_get_contents(TOPSRCDIR"/data/libwacom.stylus",
+					  &contents, &len, NULL));
+	stylus = write_datafile(datadir, "libwacom.stylus", contents);
+	g_free(contents);
+	loser = write_datafile(datadir, "loser.tablet",
+			       "[Device]\nName=Loser\nDeviceMatch=usb:1234:0001\n");
+	other = write_datafile(datadir, "other.tablet",
+			       "[Device]\nName=Other\nDeviceMatch=usb:1234:0002\n");
+
+	dirs[0] = etcdir;
+	dirs[1] = datadir;
+	db = libwacom_database_new_for_paths(2, dirs, WDATABASE_WATCH, false);
+	g_assert_nonnull(db);
+	check_watched_name(db, 1, "Loser");
+
+	/* The match is now interned in the arena of this reload */
+	g_free(write_datafile(datadir, "loser.tablet",
+			      "[Device]\nName=Loser Changed\nDeviceMatch=usb:1234:0001\n"));
+	g_assert_cmpint(libwacom_database_dispatch(db), ==, 1);
+	check_watched_name(db, 1, "Loser Changed");
+
+	/* The winner takes the match, the loser is parsed again and its
+	 * arena is released */
+	winner = write_datafile(etcdir, "winner.tablet",
+				"[Device]\nName=Winner\nDeviceMatch=usb:1234:0001\n");
+	g_assert_cmpint(libwacom_database_dispatch(db), ==, 2);
+	check_watched_name(db, 1, "Winner");
+
+	/* Reindexing and snapshots use every device_ht key */
+	g_free(write_datafile(datadir, "other.tablet",
+			      "[Device]\nName=Other Changed\nDeviceMatch=usb:1234:0002\n"));
+	g_assert_cmpint(libwacom_database_dispatch(db), ==, 1);
+	check_watched_name(db, 1, "Winner");
+	check_watched_name(db, 2, "Other Changed");
+	snapshot = libwacom_database_get_snapshot(db);
+	check_watched_name(snapshot, 1, "Winner");
+	libwacom_database_destroy(snapshot);
+
+	/* Without the winner the loser gets its match back */
+	g_assert_cmpint(unlink(winner), ==, 0);
+	g_assert_cmpint(libwacom_database_dispatch(db), ==, 1);
+	check_watched_name(db, 1, "Loser Changed");
+
+	/* A duplicate within one directory is reported like when loading,
+	 * the current owner keeps the match */
+	g_test_expect_message("libwacom", G_LOG_LEVEL_CRITICAL, "Duplicate match*");
+	duplicate = write_datafile(datadir, "duplicate.tablet",
+				   "[Device]\nName=Duplicate\nDeviceMatch=usb:1234:0002\n");
+	g_assert_cmpint(libwacom_database_dispatch(db), ==, 1);
+	g_test_assert_expected_messages();
+	check_watched_name(db, 2, "Other Changed");
+
+	libwacom_database_destroy(db);
+
+	unlink(loser);
+	unlink(other);
+	unlink(duplicate);
+	unlink(stylus);
+	g_assert_cmpint(rmdir(etcdir), ==, 0);
+	g_assert_cmpint(rmdir(datadir), ==, 0);
+	g_free(stylus);
+	g_free(loser);
+	g_free(other);
+	g_free(duplicate);
+	g_free(winner);
+	g_free(etcdir);
+	g_free(datadir);
+}
+
+int main(int argc, char **argv)
+{
+	g_test_init(&argc, &argv, NULL);
+	g_test_set_nonfatal_assertions();
+
+	g_test_add_func("/keyfile/lookup", test_keyfile_lookup);
+	g_test_add_func("/keyfile/data-files", test_keyfile_data_files);
+	g_test_add_func("/keyfile/syntax", test_keyfile_syntax);
+	g_test_add_func("/keyfile/invalid", test_keyfile_invalid);
+	g_test_add_func("/keyfile/lazy-override", test_keyfile_lazy_override);
+	g_test_add_func("/keyfile/watch-override", test_keyfile_watch_override);
+
+	return g_test_run();
+}
+
+/* vim: set noexpandtab tabstop=8 shiftwidth=8: */
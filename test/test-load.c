@@ -29,6 +29,7 @@
 #include <linux/input-event-codes.h>
 #include <glib.h>
 #include <stdlib.h>
+#include <unistd.h>
 
 #include "libwacom.h"
 
@@ -37,7 +38,7 @@ struct fixture {
 };
 
 static WacomDeviceDatabase *
-load_database(void)
+load_database(WacomDatabaseFlags flags)
 {
 	WacomDeviceDatabase *db;
 	const char *datadir;
@@ -46,7 +47,7 @@ load_database(void)
 	if (!datadir)
 		datadir = TOPSRCDIR"/data";
 
-	db = libwacom_database_new_for_path(datadir);
+	db = libwacom_database_new_for_path_with_flags(datadir, flags);
 	if (!db)
 		printf("Failed to load data from %s", datadir);
 
@@ -57,7 +58,7 @@ load_database(void)
 static void
 fixture_setup(struct fixture *f, gconstpointer user_data)
 {
-	f->db = load_database();
+	f->db = load_database(GPOINTER_TO_INT(user_data));
 }
 
 static void
@@ -250,6 +251,18 @@ test_bamboopen(struct fixture *f, gconstpointer user_data)
 	libwacom_destroy(device);
 }
 
+static void
+test_model_name(struct fixture *f, gconstpointer user_data)
+{
+	WacomDevice *device = libwacom_new_from_name(f->db, "MTE-450", NULL);
+	g_assert_nonnull(device);
+	g_assert_cmpstr(libwacom_get_name(device), ==, "Wacom Bamboo Pen");
+
+	libwacom_destroy(device);
+
+	g_assert_null(libwacom_new_from_name(f->db, "No Such Tablet", NULL));
+}
+
 static void
 test_dellcanvas(struct fixture *f, gconstpointer user_data)
 {
@@ -278,6 +291,459 @@ test_isdv4_4800(struct fixture *f, gconstpointer user_data)
 	libwacom_destroy(device);
 }
 
+static void
+test_device_outlives_database(struct fixture *f, gconstpointer user_data)
+{
+	WacomDeviceDatabase *db = load_database(WDATABASE_DEFAULT);
+	WacomDevice *device = libwacom_new_from_usbid(db, 0x56a, 0x00bc, NULL);
+	WacomDevice *other = libwacom_new_from_usbid(f->db, 0x56a, 0x00bc, NULL);
+	int nstyli, nstyli_other;
+
+	g_assert_nonnull(device);
+	libwacom_database_destroy(db);
+
+	g_assert_cmpint(libwacom_compare(device, other, WCOMPARE_MATCHES), ==, 0);
+	g_assert_cmpstr(libwacom_get_name(device), ==, "Wacom Intuos4 WL");
+	libwacom_get_supported_styli(device, &nstyli);
+	libwacom_get_supported_styli(other, &nstyli_other);
+	g_assert_cmpint(nstyli, ==, nstyli_other);
+
+	libwacom_destroy(device);
+	libwacom_destroy(other);
+}
+
+static void
+test_hash(struct fixture *f, gconstpointer user_data)
+{
+	WacomDevice *device = libwacom_new_from_usbid(f->db, 0x56a, 0x00bc, NULL);
+	WacomDevice *same = libwacom_new_from_usbid(f->db, 0x56a, 0x00bc, NULL);
+	WacomDevice *other = libwacom_new_from_usbid(f->db, 0x56a, 0x00b8, NULL);
+
+	g_assert_nonnull(device);
+	g_assert_nonnull(same);
+	g_assert_nonnull(other);
+
+	g_assert_cmpint(libwacom_compare(device, same, WCOMPARE_NORMAL), ==, 0);
+	g_assert_cmpuint(libwacom_hash(device), ==, libwacom_hash(same));
+
+	g_assert_cmpint(libwacom_compare(device, other, WCOMPARE_NORMAL), !=, 0);
+	g_assert_cmpuint(libwacom_hash(device), !=, libwacom_hash(other));
+
+	libwacom_destroy(device);
+	libwacom_destroy(same);
+	libwacom_destroy(other);
+}
+
+static void
+test_paths_unresolved(struct fixture *f, gconstpointer user_data)
+{
+	const char *paths[] = { "/dev/input/does-not-exist", NULL, "/dev/null" };
+	WacomDevice **devices;
+
+	devices = libwacom_new_from_paths(f->db, paths, G_N_ELEMENTS(paths),
+					  WFALLBACK_NONE, NULL);
+	g_assert_nonnull(devices);
+	for (size_t i = 0; i < G_N_ELEMENTS(paths); i++)
+		g_assert_null(devices[i]);
+	free(devices);
+
+	g_assert_null(libwacom_new_from_paths(f->db, NULL, 0, WFALLBACK_NONE, NULL));
+}
+
+static void
+test_stats(struct fixture *f, gconstpointer user_data)
+{
+	WacomDeviceDatabase *db = load_database(WDATABASE_STATS);
+	WacomDevice *device;
+
+	g_assert_cmpint(libwacom_database_get_stat(db, WSTAT_FILES_PARSED), >, 0);
+	g_assert_cmpint(libwacom_database_get_stat(db, WSTAT_BYTES_PARSED), >, 0);
+	g_assert_cmpint(libwacom_database_get_stat(db, WSTAT_PARSE_TIME), >=,
+			libwacom_database_get_stat(db, WSTAT_PARSE_TIME_MAX));
+	g_assert_cmpint(libwacom_database_get_stat(db, WSTAT_LOAD_TIME), >=,
+			libwacom_database_get_stat(db, WSTAT_PARSE_TIME));
+	g_assert_cmpint(libwacom_database_get_stat(db, WSTAT_NUM_MATCHES), >, 0);
+	g_assert_cmpint(libwacom_database_get_stat(db, WSTAT_NUM_STYLI), >, 0);
+	g_assert_cmpint(libwacom_database_get_stat(db, WSTAT_NUM_PENDING_MATCHES), ==, 0);
+
+	g_assert_cmpint(libwacom_database_get_stat(db, WSTAT_DEVICES_CREATED), ==, 0);
+	device = libwacom_new_from_usbid(db, 0x56a, 0x00bc, NULL);
+	g_assert_cmpint(libwacom_database_get_stat(db, WSTAT_DEVICES_CREATED), ==, 1);
+	libwacom_destroy(device);
+
+	libwacom_database_destroy(db);
+
+	/* Only the table sizes without WDATABASE_STATS */
+	g_assert_cmpint(libwacom_database_get_stat(f->db, WSTAT_FILES_PARSED), ==, 0);
+	g_assert_cmpint(libwacom_database_get_stat(f->db, WSTAT_NUM_MATCHES), >, 0);
+}
+
+static char *
+copy_data_file(const char *dir, const char *filename)
+{
+	char *src = g_build_filename(TOPSRCDIR, "data", filename, NULL);
+	char *dst = g_build_filename(dir, filename, NULL);
+	char *contents;
+	gsize len;
+
+	g_assert_true(g_file_get_contents(src, &contents, &len, NULL));
+	g_assert_true(g_file_set_contents(dst, contents, len, NULL));
+	g_free(contents);
+	g_free(src);
+
+	return dst;
+}
+
+static void
+test_watch(struct fixture *f, gconstpointer user_data)
+{
+	WacomDeviceDatabase *db, *snapshot;
+	WacomDevice *device, *wl;
+	char *tmpdir, *stylus, *tablet, *new_tablet;
+
+	tmpdir = g_dir_make_tmp("tmp.watch.XXXXXX", NULL);
+	g_assert_nonnull(tmpdir);
+	stylus = copy_data_file(tmpdir, "libwacom.stylus");
+	tablet = copy_data_file(tmpdir, "intuos4-6x9-wl.tablet");
+
+	db = libwacom_database_new_for_path_with_flags(tmpdir, WDATABASE_WATCH);
+	g_assert_nonnull(db);
+	g_assert_cmpint(libwacom_database_get_fd(db), >=, 0);
+	g_assert_cmpint(libwacom_database_dispatch(db), ==, 0);
+	snapshot = libwacom_database_get_snapshot(db);
+	g_assert_true(snapshot != db);
+
+	wl = libwacom_new_from_usbid(db, 0x56a, 0x00bc, NULL);
+	g_assert_nonnull(wl);
+	g_assert_null(libwacom_new_from_usbid(db, 0x56a, 0x00b8, NULL));
+
+	/* A new file is picked up without parsing the others */
+	new_tablet = copy_data_file(tmpdir, "intuos4-4x6.tablet");
+	g_assert_cmpint(libwacom_database_dispatch(db), ==, 1);
+	device = libwacom_new_from_usbid(db, 0x56a, 0x00b8, NULL);
+	g_assert_nonnull(device);
+	g_assert_cmpstr(libwacom_get_name(device), ==, "Wacom Intuos4 4x6");
+	libwacom_destroy(device);
+
+	/* An earlier snapshot doesn't change, a new one has the file */
+	g_assert_null(libwacom_new_from_usbid(snapshot, 0x56a, 0x00b8, NULL));
+	libwacom_database_destroy(snapshot);
+	snapshot = libwacom_database_get_snapshot(db);
+	device = libwacom_new_from_usbid(snapshot, 0x56a, 0x00b8, NULL);
+	g_assert_nonnull(device);
+	libwacom_destroy(device);
+	device = libwacom_new_from_name(db, "Wacom Intuos4 4x6", NULL);
+	g_assert_nonnull(device);
+	libwacom_destroy(device);
+
+	/* A removed file removes its devices, existing handles stay valid */
+	g_assert_cmpint(unlink(tablet), ==, 0);
+	g_assert_cmpint(libwacom_database_dispatch(db), ==, 0);
+	g_assert_null(libwacom_new_from_usbid(db, 0x56a, 0x00bc, NULL));
+	g_assert_null(libwacom_new_from_name(db, "Wacom Intuos4 WL", NULL));
+	g_assert_cmpstr(libwacom_get_name(wl), ==, "Wacom Intuos4 WL");
+	g_assert_cmpstr(libwacom_get_match(wl), ==, "usb:056a:00bc");
+
+	/* A stylus change parses all tablet files again */
+	g_free(copy_data_file(tmpdir, "libwacom.stylus"));
+	g_assert_cmpint(libwacom_database_dispatch(db), ==, 1);
+	g_assert_nonnull(libwacom_stylus_get_for_id(db, 0x802));
+
+	libwacom_destroy(wl);
+	libwacom_database_destroy(db);
+
+	/* The snapshot outlives the database */
+	g_assert_nonnull(libwacom_stylus_get_for_id(snapshot, 0x802));
+	device = libwacom_new_from_name(snapshot, "Wacom Intuos4 WL", NULL);
+	g_assert_nonnull(device);
+	libwacom_destroy(device);
+	libwacom_database_destroy(snapshot);
+
+	unlink(new_tablet);
+	unlink(stylus);
+	g_assert_cmpint(rmdir(tmpdir), ==, 0);
+	g_free(new_tablet);
+	g_free(tablet);
+	g_free(stylus);
+	g_free(tmpdir);
+}
+
+static char *
+write_tablet_file(const char *dir, const char *filename, const char *match)
+{
+	char *path = g_build_filename(dir, filename, NULL);
+	char *contents;
+
+	contents = g_strdup_printf("[Device]\nName=Same Name\nDeviceMatch=%s\n", match);
+	g_assert_true(g_file_set_contents(path, contents, -1, NULL));
+	g_free(contents);
+
+	return path;
+}
+
+static void
+check_name_lookup(WacomDeviceDatabase *db, const char *match)
+{
+	WacomDevice *device = libwacom_new_from_name(db, "Same Name", NULL);
+
+	g_assert_nonnull(device);
+	g_assert_cmpstr(libwacom_get_match(device), ==, match);
+	libwacom_destroy(device);
+}
+
+/* Like when loading, the first file with a name wins after a reload */
+static void
+test_watch_name_order(struct fixture *f, gconstpointer user_data)
+{
+	WacomDeviceDatabase *db, *snapshot;
+	char *tmpdir, *stylus, *a, *b, *c;
+
+	tmpdir = g_dir_make_tmp("tmp.watch.XXXXXX", NULL);
+	g_assert_nonnull(tmpdir);
+	stylus = copy_data_file(tmpdir, "libwacom.stylus");
+	a = write_tablet_file(tmpdir, "a.tablet", "usb:1234:0001");
+	b = write_tablet_file(tmpdir, "b.tablet", "usb:1234:0002");
+
+	db = libwacom_database_new_for_path_with_flags(tmpdir, WDATABASE_WATCH);
+	g_assert_nonnull(db);
+	check_name_lookup(db, "usb:1234:0001");
+
+	/* Unrelated and later files don't change the winner */
+	c = write_tablet_file(tmpdir, "c.tablet", "usb:1234:0003");
+	g_assert_cmpint(libwacom_database_dispatch(db), ==, 1);
+	check_name_lookup(db, "usb:1234:0001");
+	g_free(write_tablet_file(tmpdir, "b.tablet", "usb:1234:0004"));
+	g_assert_cmpint(libwacom_database_dispatch(db), ==, 1);
+	check_name_lookup(db, "usb:1234:0001");
+	snapshot = libwacom_database_get_snapshot(db);
+	check_name_lookup(snapshot, "usb:1234:0001");
+	libwacom_database_destroy(snapshot);
+
+	g_assert_cmpint(unlink(a), ==, 0);
+	g_assert_cmpint(libwacom_database_dispatch(db), ==, 0);
+	check_name_lookup(db, "usb:1234:0004");
+
+	libwacom_database_destroy(db);
+
+	unlink(b);
+	unlink(c);
+	unlink(stylus);
+	g_assert_cmpint(rmdir(tmpdir), ==, 0);
+	g_free(a);
+	g_free(b);
+	g_free(c);
+	g_free(stylus);
+	g_free(tmpdir);
+}
+
+/* The database flags must not change the content of the database */
+static void
+test_same_devices(struct fixture *f, gconstpointer user_data)
+{
+	WacomDeviceDatabase *db = load_database(WDATABASE_DEFAULT);
+	WacomDevice **devices, **other_devices;
+	int i;
+
+	/* Resolve one device before listing everything */
+	libwacom_destroy(libwacom_new_from_usbid(f->db, 0x56a, 0x00bc, NULL));
+
+	devices = libwacom_list_devices_from_database(db, NULL);
+	other_devices = libwacom_list_devices_from_database(f->db, NULL);
+	for (i = 0; devices[i] && other_devices[i]; i++) {
+		g_assert_cmpint(libwacom_compare(devices[i], other_devices[i], WCOMPARE_MATCHES), ==, 0);
+		g_assert_cmpuint(libwacom_hash(devices[i]), ==, libwacom_hash(other_devices[i]));
+	}
+	g_assert_null(devices[i]);
+	g_assert_null(other_devices[i]);
+
+	free(devices);
+	free(other_devices);
+	libwacom_database_destroy(db);
+}
+
+static void
+test_device_list(struct fixture *f, gconstpointer user_data)
+{
+	const WacomDevice * const *devices;
+	WacomDevice **list;
+	int ndevices, i;
+
+	devices = libwacom_database_get_devices(f->db, &ndevices);
+	g_assert_nonnull(devices);
+	g_assert_cmpint(ndevices, >, 0);
+	g_assert_null(devices[ndevices]);
+
+	/* The list is only built once */
+	g_assert_true(libwacom_database_get_devices(f->db, NULL) == devices);
+
+	list = libwacom_list_devices_from_database(f->db, NULL);
+	for (i = 0; list[i]; i++)
+		g_assert_true(list[i] == devices[i]);
+	g_assert_cmpint(i, ==, ndevices);
+	free(list);
+}
+
+static gboolean
+device_has_bus_and_vendor(const WacomDevice *device, WacomBusType bus, int vendor_id)
+{
+	const WacomMatch **matches = libwacom_get_matches(device);
+	gboolean has_bus = bus == WBUSTYPE_UNKNOWN;
+	gboolean has_vendor = vendor_id == -1;
+
+	for (; *matches; matches++) {
+		if (libwacom_match_get_bustype(*matches) == bus)
+			has_bus = TRUE;
+		if (libwacom_match_get_vendor_id(*matches) == vendor_id)
+			has_vendor = TRUE;
+	}
+
+	return has_bus && has_vendor;
+}
+
+static void
+check_query(const WacomDeviceDatabase *db, WacomQueryFlags flags,
+	    WacomClass cls, WacomBusType bus, int vendor_id)
+{
+	const WacomDevice * const *all;
+	const WacomDevice **result;
+	int nall, nresult, n = 0;
+
+	all = libwacom_database_get_devices(db, &nall);
+	nresult = libwacom_database_query_devices(db, flags, cls, bus, vendor_id, NULL, 0);
+	g_assert_cmpint(nresult, <=, nall);
+
+	result = g_new0(const WacomDevice *, nresult + 1);
+	g_assert_cmpint(libwacom_database_query_devices(db, flags, cls, bus, vendor_id,
+							result, nresult), ==, nresult);
+
+	for (int i = 0; i < nall; i++) {
+		const WacomDevice *d = all[i];
+		WacomIntegrationFlags integration = libwacom_get_integration_flags(d);
+
+		if ((flags & WQUERY_STYLUS) && !libwacom_has_stylus(d))
+			continue;
+		if ((flags & WQUERY_TOUCH) && !libwacom_has_touch(d))
+			continue;
+		if ((flags & WQUERY_RING) && !libwacom_has_ring(d))
+			continue;
+		if ((flags & WQUERY_RING2) && !libwacom_has_ring2(d))
+			continue;
+		if ((flags & WQUERY_TOUCHSTRIP) && libwacom_get_num_strips(d) == 0)
+			continue;
+		if ((flags & WQUERY_TOUCHSWITCH) && !libwacom_has_touchswitch(d))
+			continue;
+		if ((flags & WQUERY_REVERSIBLE) && !libwacom_is_reversible(d))
+			continue;
+		if ((flags & WQUERY_INTEGRATED_DISPLAY) &&
+		    !(integration & WACOM_DEVICE_INTEGRATED_DISPLAY))
+			continue;
+		if ((flags & WQUERY_INTEGRATED_SYSTEM) &&
+		    !(integration & WACOM_DEVICE_INTEGRATED_SYSTEM))
+			continue;
+		if (cls != WCLASS_UNKNOWN && libwacom_get_class(d) != cls)
+			continue;
+		if (!device_has_bus_and_vendor(d, bus, vendor_id))
+			continue;
+
+		g_assert_cmpint(n, <, nresult);
+		g_assert_true(result[n] == d);
+		n++;
+	}
+	g_assert_cmpint(n, ==, nresult);
+
+	g_free(result);
+}
+
+static void
+test_query(struct fixture *f, gconstpointer user_data)
+{
+	const WacomDevice *device;
+	int ndevices;
+
+	libwacom_database_get_devices(f->db, &ndevices);
+	g_assert_cmpint(libwacom_database_query_devices(f->db, 0, WCLASS_UNKNOWN,
+							WBUSTYPE_UNKNOWN, -1,
+							NULL, 0), ==, ndevices);
+
+	check_query(f->db, WQUERY_RING, WCLASS_UNKNOWN, WBUSTYPE_UNKNOWN, -1);
+	check_query(f->db, WQUERY_INTEGRATED_DISPLAY, WCLASS_UNKNOWN, WBUSTYPE_UNKNOWN, -1);
+	check_query(f->db, WQUERY_STYLUS | WQUERY_TOUCH | WQUERY_TOUCHSWITCH,
+		    WCLASS_UNKNOWN, WBUSTYPE_USB, -1);
+	check_query(f->db, WQUERY_TOUCHSTRIP, WCLASS_CINTIQ, WBUSTYPE_UNKNOWN, 0x56a);
+	check_query(f->db, 0, WCLASS_UNKNOWN, WBUSTYPE_BLUETOOTH, -1);
+	check_query(f->db, WQUERY_INTEGRATED_SYSTEM, WCLASS_ISDV4, WBUSTYPE_I2C, -1);
+	check_query(f->db, WQUERY_REVERSIBLE | WQUERY_RING2, WCLASS_UNKNOWN,
+		    WBUSTYPE_UNKNOWN, 0x56a);
+
+	/* The Intuos4 6x9 has a ring */
+	g_assert_cmpint(libwacom_database_query_devices(f->db, WQUERY_RING,
+							WCLASS_INTUOS4, WBUSTYPE_USB,
+							0x56a, &device, 1), >, 0);
+	g_assert_true(libwacom_has_ring(device));
+
+	g_assert_cmpint(libwacom_database_query_devices(f->db, 0, WCLASS_UNKNOWN,
+							WBUSTYPE_UNKNOWN, 0x7fffffff,
+							NULL, 0), ==, 0);
+}
+
+#define NUM_THREADS 8
+
+/* Runs every kind of lookup on all devices in the database, the result
+ * is compared with the same lookups done before the threads started. */
+static gpointer
+lookup_thread(gpointer data)
+{
+	WacomDeviceDatabase *db = data;
+	WacomDevice **devices;
+
+	for (int iteration = 0; iteration < 10; iteration++) {
+		devices = libwacom_list_devices_from_database(db, NULL);
+		g_assert_nonnull(devices);
+
+		for (WacomDevice **d = devices; *d; d++) {
+			const WacomMatch *match = libwacom_get_matches(*d)[0];
+			const int *styli;
+			int nstyli;
+			WacomDevice *device;
+
+			device = libwacom_new_from_usbid(db,
+							 libwacom_match_get_vendor_id(match),
+							 libwacom_match_get_product_id(match),
+							 NULL);
+			if (device) {
+				g_assert_cmpint(libwacom_get_vendor_id(device), ==,
+						libwacom_match_get_vendor_id(match));
+				libwacom_destroy(device);
+			}
+
+			device = libwacom_new_from_name(db, libwacom_get_name(*d), NULL);
+			g_assert_nonnull(device);
+			g_assert_cmpstr(libwacom_get_name(device), ==, libwacom_get_name(*d));
+			libwacom_destroy(device);
+
+			styli = libwacom_get_supported_styli(*d, &nstyli);
+			for (int i = 0; i < nstyli; i++)
+				g_assert_nonnull(libwacom_stylus_get_for_id(db, styli[i]));
+		}
+
+		free(devices);
+	}
+
+	return NULL;
+}
+
+/* Run with -Db_sanitize=thread to check for data races */
+static void
+test_threads(struct fixture *f, gconstpointer user_data)
+{
+	GThread *threads[NUM_THREADS];
+
+	for (int i = 0; i < NUM_THREADS; i++)
+		threads[i] = g_thread_new("lookup", lookup_thread, f->db);
+	for (int i = 0; i < NUM_THREADS; i++)
+		g_thread_join(threads[i]);
+}
+
 int main(int argc, char **argv)
 {
 	g_test_init(&argc, &argv, NULL);
@@ -310,6 +776,9 @@ int main(int argc, char **argv)
 	g_test_add("/load/056a:0065", struct fixture, NULL,
 		   fixture_setup, test_bamboopen,
 		   fixture_teardown);
+	g_test_add("/load/056a:0065/model-name", struct fixture, NULL,
+		   fixture_setup, test_model_name,
+		   fixture_teardown);
 	g_test_add("/load/056a:4200", struct fixture, NULL,
 		   fixture_setup, test_dellcanvas,
 		   fixture_teardown);
@@ -319,6 +788,65 @@ int main(int argc, char **argv)
 	g_test_add("/load/056a:4800", struct fixture, NULL,
 		   fixture_setup, test_isdv4_4800,
 		   fixture_teardown);
+	g_test_add("/load/device-outlives-database", struct fixture, NULL,
+		   fixture_setup, test_device_outlives_database,
+		   fixture_teardown);
+	g_test_add("/load/devices", struct fixture, NULL,
+		   fixture_setup, test_device_list,
+		   fixture_teardown);
+	g_test_add("/load/query", struct fixture, NULL,
+		   fixture_setup, test_query,
+		   fixture_teardown);
+	g_test_add("/load/stats", struct fixture, NULL,
+		   fixture_setup, test_stats,
+		   fixture_teardown);
+	g_test_add("/load/watch", struct fixture, NULL,
+		   fixture_setup, test_watch,
+		   fixture_teardown);
+	g_test_add("/load/watch/name-order", struct fixture, NULL,
+		   fixture_setup, test_watch_name_order,
+		   fixture_teardown);
+	g_test_add("/load/hash", struct fixture, NULL,
+		   fixture_setup, test_hash,
+		   fixture_teardown);
+	g_test_add("/load/paths/unresolved", struct fixture, NULL,
+		   fixture_setup, test_paths_unresolved,
+		   fixture_teardown);
+	g_test_add("/load/threads", struct fixture, NULL,
+		   fixture_setup, test_threads,
+		   fixture_teardown);
+	g_test_add("/load/lazy/0000:0000", struct fixture,
+		   GINT_TO_POINTER(WDATABASE_LAZY),
+		   fixture_setup, test_invalid_device,
+		   fixture_teardown);
+	g_test_add("/load/lazy/056a:00bc", struct fixture,
+		   GINT_TO_POINTER(WDATABASE_LAZY),
+		   fixture_setup, test_intuos4,
+		   fixture_teardown);
+	g_test_add("/load/lazy/056a:00b8", struct fixture,
+		   GINT_TO_POINTER(WDATABASE_LAZY),
+		   fixture_setup, test_intuos4_wl,
+		   fixture_teardown);
+	g_test_add("/load/lazy/devices", struct fixture,
+		   GINT_TO_POINTER(WDATABASE_LAZY),
+		   fixture_setup, test_same_devices,
+		   fixture_teardown);
+	g_test_add("/load/lazy/device-list", struct fixture,
+		   GINT_TO_POINTER(WDATABASE_LAZY),
+		   fixture_setup, test_device_list,
+		   fixture_teardown);
+	g_test_add("/load/lazy/threads", struct fixture,
+		   GINT_TO_POINTER(WDATABASE_LAZY),
+		   fixture_setup, test_threads,
+		   fixture_teardown);
+	g_test_add("/load/parallel/056a:00bc", struct fixture,
+		   GINT_TO_POINTER(WDATABASE_PARALLEL),
+		   fixture_setup, test_intuos4,
+		   fixture_teardown);
+	g_test_add("/load/parallel/devices", struct fixture,
+		   GINT_TO_POINTER(WDATABASE_PARALLEL),
+		   fixture_setup, test_same_devices,
+		   fixture_teardown);
 
 	return g_test_run();
 }
@@ -0,0 +1,60 @@
+#!/usr/bin/env python3
+#
+# Copyright © 2026 Red Hat, Inc.
+#
+# Permission to use, copy, modify, distribute, and sell this software
+# and its documentation for any purpose is hereby granted without
+# fee, provided that the above copyright notice appear in all copies
+# and that both that copyright notice and this permission notice
+# appear in supporting documentation, and that the name of Red Hat
+# not be used in advertising or publicity pertaining to distribution
+# of the software without specific, written prior permission.  Red
+# Hat makes no representations about the suitability of this software
+# for any purpose.  It is provided "as is" without express or implied
+# warranty.
+#
+# THE AUTHORS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS SOFTWARE,
+# INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS, IN
+# NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+# CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS
+# OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT,
+# NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+# CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+#
+# Turns a database cache written by libwacom-update-cache into a C
+# source file that replaces libwacom/libwacom-embedded.c, so the
+# database is compiled into libwacom.so. See the embedded-database
+# meson option.
+
+import argparse
+from pathlib import Path
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Embed a libwacom database cache")
+    parser.add_argument("cache", type=Path, help="Cache file to embed")
+    parser.add_argument("output", type=Path, help="C file to write")
+    args = parser.parse_args()
+
+    data = args.cache.read_bytes()
+
+    with open(args.output, "w") as out:
+        out.write(f"/* Generated by embed-database.py from {args.cache.name}, do not edit */\n\n")
+        out.write('#include "config.h"\n\n')
+        out.write('#include "libwacomint.h"\n\n')
+        # The cache reader casts its sections in place
+        out.write("static const unsigned char image[] __attribute__((aligned(8))) = {\n")
+        for i in range(0, len(data), 16):
+            line = ", ".join(f"0x{b:02x}" for b in data[i : i + 16])
+            out.write(f"\t{line},\n")
+        out.write("};\n\n")
+        out.write("const char *\n")
+        out.write("libwacom_embedded_image(size_t *len)\n")
+        out.write("{\n")
+        out.write("\t*len = sizeof(image);\n")
+        out.write("\treturn (const char *)image;\n")
+        out.write("}\n")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,207 @@
+#!/usr/bin/env python3
+#
+# Copyright © 2026 Red Hat, Inc.
+#
+# Permission to use, copy, modify, distribute, and sell this software
+# and its documentation for any purpose is hereby granted without
+# fee, provided that the above copyright notice appear in all copies
+# and that both that copyright notice and this permission notice
+# appear in supporting documentation, and that the name of Red Hat
+# not be used in advertising or publicity pertaining to distribution
+# of the software without specific, written prior permission.  Red
+# Hat makes no representations about the suitability of this software
+# for any purpose.  It is provided "as is" without express or implied
+# warranty.
+#
+# THE AUTHORS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS SOFTWARE,
+# INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS, IN
+# NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+# CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS
+# OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT,
+# NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+# CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+#
+# Generates a data directory with synthetic but valid .tablet and
+# .stylus files to benchmark the database at a multiple of its
+# current size, e.g.
+#
+#   generate-synthetic-database.py --tablets 40000 /tmp/synthetic
+#   LIBWACOM_DATA_DIR=/tmp/synthetic meson test -C builddir --suite bench
+#
+# The output is deterministic for a given set of arguments.
+
+import argparse
+import random
+import sys
+from pathlib import Path
+
+# Vendor IDs not used by any device in data/
+VENDOR_BASE = 0xF000
+
+BUSES = ["usb", "usb", "usb", "bluetooth", "i2c"]
+CLASSES = ["Bamboo", "Cintiq", "Intuos4", "Intuos5", "PenDisplay", "ISDV4"]
+STYLUS_TYPES = ["General", "Classic", "Inking", "Airbrush", "Marker", "Mobile"]
+AXES = ["Tilt;Pressure;Distance;", "Pressure;Distance;", "Pressure;"]
+
+# IDs below this are used by the shipped libwacom.stylus
+STYLUS_BASE = 0x200000
+STYLI_PER_GROUP = 4
+
+
+def button_names(count):
+    return [chr(ord("A") + i) for i in range(count)]
+
+
+def write_styli(path, nstyli):
+    """
+    Writes nstyli styli in groups of STYLI_PER_GROUP and returns the
+    list of group names. Every other stylus has a paired eraser.
+    """
+    groups = []
+    with open(path, "w") as fd:
+        print("# Synthetic styli, generated by generate-synthetic-database.py", file=fd)
+        sid = STYLUS_BASE
+        for i in range(nstyli):
+            group = f"synthetic-{i // STYLI_PER_GROUP}"
+            if not groups or groups[-1] != group:
+                groups.append(group)
+
+            has_eraser = i % 2 == 0
+            print(f"\n[{sid:#x}]", file=fd)
+            print(f"Name=Synthetic Pen {i}", file=fd)
+            print(f"Group={group}", file=fd)
+            if has_eraser:
+                print(f"PairedStylusIds={sid + 1:#x};", file=fd)
+            print(f"Buttons={random.randint(0, 3)}", file=fd)
+            print(f"Axes={random.choice(AXES)}", file=fd)
+            print(f"Type={random.choice(STYLUS_TYPES)}", file=fd)
+
+            if has_eraser:
+                print(f"\n[{sid + 1:#x}]", file=fd)
+                print(f"Name=Synthetic Pen {i} Eraser", file=fd)
+                print(f"Group={group}", file=fd)
+                print(f"PairedStylusIds={sid:#x};", file=fd)
+                print("EraserType=Invert", file=fd)
+                print(f"Axes={random.choice(AXES)}", file=fd)
+                print("Type=General", file=fd)
+                sid += 1
+            sid += 1
+
+    return groups
+
+
+def write_tablet(path, index, matches, groups):
+    name = f"Synthetic Tablet {index}"
+    nbuttons = random.choice([0, 0, 4, 6, 8, 9, 13, 18])
+    ring = nbuttons > 0 and random.random() < 0.3
+    touch = random.random() < 0.5
+    integrated = random.random() < 0.2
+
+    styli = []
+    if groups:
+        styli = [f"@{g}" for g in random.sample(groups, min(len(groups), random.randint(1, 3)))]
+    styli.append(f"{0xFFFFF:#x}")
+
+    with open(path, "w") as fd:
+        print("[Device]", file=fd)
+        print(f"Name={name}", file=fd)
+        print(f"ModelName=SYN-{index:05d}", file=fd)
+        print(f"DeviceMatch={';'.join(matches)};", file=fd)
+        print(f"Class={random.choice(CLASSES)}", file=fd)
+        print(f"Width={random.randint(4, 24)}", file=fd)
+        print(f"Height={random.randint(3, 16)}", file=fd)
+        print(f"IntegratedIn={'Display;' if integrated else ''}", file=fd)
+        print(f"Styli={';'.join(styli)};", file=fd)
+        print("", file=fd)
+        print("[Features]", file=fd)
+        print("Stylus=true", file=fd)
+        print(f"Reversible={'false' if integrated else 'true'}", file=fd)
+        print(f"Touch={'true' if touch else 'false'}", file=fd)
+        if ring:
+            print("Ring=true", file=fd)
+
+        if nbuttons:
+            buttons = button_names(nbuttons)
+            print("", file=fd)
+            print("[Buttons]", file=fd)
+            print(f"Left={';'.join(buttons)}", file=fd)
+            if ring:
+                print(f"Ring={buttons[0]}", file=fd)
+                print("RingNumModes=4", file=fd)
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description="Generate a synthetic libwacom data directory for benchmarking"
+    )
+    parser.add_argument("output", type=Path, help="Directory to write the data files to")
+    parser.add_argument(
+        "--tablets", type=int, default=4000, help="Number of .tablet files (default: 4000)"
+    )
+    parser.add_argument(
+        "--styli", type=int, default=400, help="Number of styli, excluding erasers (default: 400)"
+    )
+    parser.add_argument(
+        "--max-matches",
+        type=int,
+        default=4,
+        help="Maximum number of DeviceMatch entries per tablet (default: 4)",
+    )
+    parser.add_argument(
+        "--with-data",
+        type=Path,
+        default=None,
+        help="Also link the data files from this directory, e.g. data/, so the "
+        "result is the shipped database plus the synthetic files",
+    )
+    parser.add_argument("--seed", type=int, default=0, help="Random seed (default: 0)")
+    ns = parser.parse_args()
+
+    if ns.tablets < 0 or ns.styli < 0 or ns.max_matches < 1:
+        print("Invalid arguments", file=sys.stderr)
+        sys.exit(1)
+
+    random.seed(ns.seed)
+    ns.output.mkdir(parents=True, exist_ok=True)
+
+    if ns.with_data:
+        for f in ns.with_data.iterdir():
+            if f.suffix in [".tablet", ".stylus"] or f.name == "layouts":
+                target = ns.output / f.name
+                if not target.exists():
+                    target.symlink_to(f.resolve())
+
+    groups = write_styli(ns.output / "synthetic.stylus", ns.styli)
+
+    # The generic pen 0xfffff is referenced by every tablet, provide it
+    # unless it comes with the shipped data
+    if not ns.with_data:
+        with open(ns.output / "generic.stylus", "w") as fd:
+            print("[0xfffff]", file=fd)
+            print("Name=General Pen", file=fd)
+            print("Group=generic-no-eraser", file=fd)
+            print("Buttons=2", file=fd)
+            print("Axes=Tilt;Pressure;Distance;", file=fd)
+            print("Type=General", file=fd)
+
+    # Every match is unique, each tablet gets a contiguous range of
+    # product IDs and the vendor ID moves on when those run out
+    match_id = 0
+    for i in range(ns.tablets):
+        matches = []
+        for _ in range(random.randint(1, ns.max_matches)):
+            vid = VENDOR_BASE + (match_id >> 16)
+            pid = match_id & 0xFFFF
+            bus = random.choice(BUSES)
+            # Some matches also carry the device name
+            if random.random() < 0.1:
+                matches.append(f"{bus}:{vid:04x}:{pid:04x}:Synthetic Tablet {i} Pen")
+            else:
+                matches.append(f"{bus}:{vid:04x}:{pid:04x}")
+            match_id += 1
+
+        write_tablet(ns.output / f"synthetic-{i:06d}.tablet", i, matches, groups)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,105 @@
+/*
+ * Copyright © 2026 Red Hat, Inc.
+ *
+ * Permission to use, copy, modify, distribute, and sell this software
+ * and its documentation for any purpose is hereby granted without
+ * fee, provided that the above copyright notice appear in all copies
+ * and that both that copyright notice and this permission notice
+ * appear in supporting documentation, and that the name of Red Hat
+ * not be used in advertising or publicity pertaining to distribution
+ * of the software without specific, written prior permission.  Red
+ * Hat makes no representations about the suitability of this software
+ * for any purpose.  It is provided "as is" without express or implied
+ * warranty.
+ *
+ * THE AUTHORS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS SOFTWARE,
+ * INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS, IN
+ * NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS
+ * OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT,
+ * NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <glib/gi18n.h>
+#include <glib.h>
+#include "libwacomint.h"
+
+static char *output_path;
+static char **install_dirs;
+
+static GOptionEntry opts[] = {
+	{ "output", 0, 0, G_OPTION_ARG_FILENAME, &output_path, N_("Path of the cache file to write"), NULL },
+	{ "install-dir", 0, 0, G_OPTION_ARG_FILENAME_ARRAY, &install_dirs, N_("Installed location of each data directory"), NULL },
+	{ .long_name = NULL}
+};
+
+int main(int argc, char **argv)
+{
+	WacomDeviceDatabase *db;
+	WacomError *error;
+	GOptionContext *context;
+	GError *gerror = NULL;
+	const char *default_dirs[] = { ETCDIR, DATADIR };
+	const char **datadirs;
+	size_t ndirs;
+	char *path;
+	int rc = EXIT_FAILURE;
+
+	context = g_option_context_new ("[DATADIR...]");
+	g_option_context_add_main_entries (context, opts, NULL);
+	if (!g_option_context_parse (context, &argc, &argv, &gerror)) {
+		if (gerror != NULL) {
+			fprintf (stderr, "%s\n", gerror->message);
+			g_error_free (gerror);
+		}
+		return EXIT_FAILURE;
+	}
+	g_option_context_free (context);
+
+	/* The cache is only valid for the exact list of directories it was
+	 * generated from, in that order. */
+	if (argc > 1) {
+		datadirs = (const char **)&argv[1];
+		ndirs = argc - 1;
+	} else {
+		datadirs = default_dirs;
+		ndirs = G_N_ELEMENTS(default_dirs);
+	}
+
+	if (install_dirs && g_strv_length(install_dirs) != ndirs) {
+		fprintf(stderr, "Need one --install-dir for each data directory.\n");
+		return EXIT_FAILURE;
+	}
+
+	db = libwacom_database_new_for_paths(ndirs, datadirs, WDATABASE_DEFAULT, false);
+	if (!db) {
+		fprintf(stderr, "Failed to load device database.\n");
+		return EXIT_FAILURE;
+	}
+
+	path = output_path ? g_strdup(output_path) :
+			     g_build_filename(datadirs[0], CACHE_FILENAME, NULL);
+
+	error = libwacom_error_new();
+	if (!libwacom_cache_write(db, ndirs, datadirs, (const char **)install_dirs,
+				  path, error))
+		fprintf(stderr, "Failed to write %s: %s\n", path,
+			libwacom_error_get_message(error));
+	else
+		rc = EXIT_SUCCESS;
+
+	libwacom_error_free(&error);
+	libwacom_database_destroy(db);
+	g_free(path);
+	g_free(output_path);
+	g_strfreev(install_dirs);
+
+	return rc;
+}
+
+/* vim: set noexpandtab tabstop=8 shiftwidth=8: */